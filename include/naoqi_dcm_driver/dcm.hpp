@@ -21,27 +21,42 @@
 // NAOqi Headers
 #include <qi/session.hpp>
 
+#include "naoqi_dcm_driver/rpc_proxy.hpp"
+
 /**
  * @brief This class is a wapper for Naoqi DCM Class
  */
 class DCM
 {
 public:
-  DCM(const qi::SessionPtr& session,
+  DCM(const qi::AnyObject& proxy,
       const double &controller_freq);
 
   //! @brief initialize all Aliases
   bool init(const std::vector <std::string> &joints);
 
+  //! @brief use a new DCM proxy, the aliases must be defined again with init
+  void setProxy(const qi::AnyObject& proxy);
+
+  //! @brief change the joints to control, keeping the Hardness alias
+  bool setJoints(const std::vector <std::string> &joints);
+
   //! @brief update joints values
   void writeJoints(const std::vector <double> &joint_commands);
 
+  //! @brief update joints values with a velocity feedforward
+  void writeJoints(const std::vector <double> &joint_commands,
+                   const std::vector <double> &joint_velocities);
+
   //! @brief update joints stiffness
   bool setStiffness(const float &stiffness);
 
   //! @brief get time from the DCM proxy
   int getTime(const int &offset);
 
+  //! @brief how far ahead writeJoints extrapolates the commands with their velocity [s]
+  double getCommandLead() const;
+
 private:
   //! @brief initialize of DCM Motion commands
   void createPositionActuatorCommand(const std::vector <std::string> &joints);
@@ -59,7 +74,7 @@ private:
                             const std::string& type_update="Merge");
 
   /** DCM proxy */
-  qi::AnyObject dcm_proxy_;
+  RpcProxy dcm_proxy_;
 
   /** alias to send DCM commands */
   std::vector <qi::AnyValue> commands_;
@@ -21,7 +21,15 @@
 // NAOqi Headers
 #include <qi/session.hpp>
 
+#include <ros/ros.h>
+
 #include <diagnostic_updater/DiagnosticStatusWrapper.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <std_msgs/Float32MultiArray.h>
+
+#include "naoqi_dcm_driver/rpc_proxy.hpp"
+#include "naoqi_dcm_driver/sliding_stats.hpp"
+#include "naoqi_dcm_driver/thermal_model.hpp"
 
 /**
  * @brief This class defines a Diagnostic
@@ -32,15 +40,15 @@ class Diagnostics
 public:
   /**
   * @brief Constructor
-  * @param session[in] Naoqi session
+  * @param memory_proxy[in] Naoqi Memory proxy
   * @param pub[in] ROS topic publisher
+  * @param stats_pub[in] ROS publisher of the joints statistics
   * @param joints_all_names[in] all joints to check
-  * @param robot[in] robot type
   */
-  Diagnostics(const qi::SessionPtr& session,
+  Diagnostics(const qi::AnyObject& memory_proxy,
               ros::Publisher *pub,
-              const std::vector<std::string> &joints_all_names,
-              const std::string &robot);
+              ros::Publisher *stats_pub,
+              const std::vector<std::string> &joints_all_names);
 
   //! @brief destroys all ros nodehandle and shutsdown all publisher
   virtual ~Diagnostics() {}
@@ -48,21 +56,71 @@ public:
   //! @brief publish the newly received data
   bool publish();
 
+  //! @brief use a new Memory proxy
+  void setProxy(const qi::AnyObject& memory_proxy);
+
+  //! @brief predicted time before each joint reaches the error temperature [s], in the joints order
+  const std::vector <float>& getTimesToError() const;
+
+  //! @brief joints whose stiffness must be derated, in the joints order
+  const std::vector <bool>& getForcedJoints() const;
+
+  //! @brief joints names, in the order of the per joint results
+  const std::vector <std::string>& getJointsNames() const;
+
+  /**
+  * @brief load the emission policy: diagnostics_heartbeat and
+  * diagnostics_hysteresis/{battery,temperature,stiffness,current},
+  * the thermal models: thermal_model/{sample_period,forgetting},
+  * the joints statistics: joint_stats/{window,ema_alpha,period},
+  * the keys polling rates: diagnostics_rates/{battery,temperature,current}, and the derating
+  * thresholds: derating/{temperature,temperature_hysteresis,current,current_hysteresis,time_to_error}
+  */
+  void loadParams(const ros::NodeHandle &nh);
+
   //! @brief set the message based on level
-  void setMessageFromStatus(diagnostic_updater::DiagnosticStatusWrapper &status);
+  void setMessageFromStatus(diagnostic_msgs::DiagnosticStatus &status);
 
   //! @brief set the aggregated message
-  void setAggregatedMessage(diagnostic_updater::DiagnosticStatusWrapper &status);
+  void setAggregatedMessage(const diagnostic_msgs::DiagnosticStatus &status);
 
   //! @brief return the status message
   std::string getStatusMsg();
 
 private:
+  /** kinds of numeric fields, each with its own hysteresis */
+  enum Field
+  {
+    FIELD_BATTERY = 0,
+    FIELD_TEMPERATURE,
+    FIELD_STIFFNESS,
+    FIELD_CURRENT,
+    FIELD_COUNT
+  };
+
+  //! @brief add a numeric field of a status to the emission policy
+  void addField(const size_t &status, const Field &field);
+
+  //! @brief set the value of a numeric field and its text
+  void setValue(const size_t &slot, const float &value, std::string *str);
+
+  //! @brief publish the statuses which changed, or all of them on heartbeat
+  void emit(const ros::Time &ts);
+
+  //! @brief read the due tiers, each in its own request issued together, return false on failure
+  bool readTiers(const ros::Time &ts);
+
+  //! @brief publish the joints statistics every stats_period_
+  void publishStats(const ros::Time &ts);
+
   /** diagnostics publisher */
   ros::Publisher *pub_;
 
+  /** joints statistics publisher */
+  ros::Publisher *stats_pub_;
+
   /** Memory proxy */
-  qi::AnyObject memory_proxy_;
+  RpcProxy memory_proxy_;
 
   /** joints names */
   std::vector <std::string> joints_all_names_;
@@ -70,9 +128,97 @@ private:
   /** joints electric current */
   std::vector <float> joints_current_;
 
-  /** all the keys to check. It is a concatenation of
-   * temperatures_keys, stiffness_keys, current_keys */
-  std::vector <std::string> keys_tocheck_;
+  /** diagnostics message built once, only its levels and values are updated.
+   * It is copied on write when still used by subscribers.
+   * status: battery, one per joint, then the aggregated joints status */
+  boost::shared_ptr <diagnostic_msgs::DiagnosticArray> msg_;
+
+  /** sliding window statistics of each joint */
+  std::vector <SlidingStats> current_stats_;
+  std::vector <SlidingStats> temperature_stats_;
+
+  /** joints statistics, one row per joint: current mean, rms, peak, ema,
+   * temperature mean, peak, ema. It is copied on write when still used by subscribers */
+  boost::shared_ptr <std_msgs::Float32MultiArray> stats_msg_;
+
+  /** period of the joints statistics, never published if 0 */
+  double stats_period_;
+
+  /** time of the last joints statistics */
+  ros::Time last_stats_;
+
+  /** thermal model of each joint */
+  std::vector <ThermalModel> thermal_models_;
+
+  /** predicted time before each joint reaches the error temperature */
+  std::vector <float> times_to_error_;
+
+  /** joints whose stiffness must be derated, only written and read by the loop thread */
+  std::vector <bool> forced_joints_;
+
+  /** a joint is forced from these temperature, current, or predicted time to error */
+  float derating_temperature_;
+  float derating_current_;
+  float derating_time_to_error_;
+
+  /** a forced joint is released below these temperature and current, and
+   * above twice the predicted time to error */
+  float derating_temperature_hysteresis_;
+  float derating_current_hysteresis_;
+
+  /** error message of each joint */
+  std::vector <std::string> joints_error_messages_;
+
+  /** statuses which changed, published between two heartbeats */
+  boost::shared_ptr <diagnostic_msgs::DiagnosticArray> changes_msg_;
+
+  /** numeric fields in the order they are set: status index, kind,
+   * current value and last published value */
+  std::vector <size_t> fields_status_;
+  std::vector <Field> fields_kind_;
+  std::vector <float> fields_value_;
+  std::vector <float> fields_published_;
+
+  /** last published level of each status */
+  std::vector <int> published_levels_;
+
+  /** statuses to publish */
+  std::vector <bool> dirty_;
+
+  /** minimal change of a field to be published */
+  float hysteresis_[FIELD_COUNT];
+
+  /** period of the full snapshots, every call if 0 */
+  double heartbeat_;
+
+  /** time of the last full snapshot */
+  ros::Time last_snapshot_;
+
+  /** keys read at their own rate, each tier in its own request:
+   * battery charge; temperature and hardness per joint; electric current per joint */
+  enum Tier
+  {
+    TIER_BATTERY = 0,
+    TIER_TEMPERATURE,
+    TIER_CURRENT,
+    TIER_COUNT
+  };
+
+  struct KeysTier
+  {
+    /** keys of the tier */
+    std::vector <std::string> keys;
+    /** period between two reads, every call if 0 */
+    double period;
+    /** time of the last read */
+    ros::Time last;
+    /** values of the last read */
+    std::vector <float> values;
+    /** the tier was read by this call */
+    bool updated;
+  };
+
+  KeysTier tiers_[TIER_COUNT];
 
   /** the temperature to alert a warning */
   float temperature_warn_level_;
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef FAKE_ROBOT_HPP
+#define FAKE_ROBOT_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * @brief This class simulates the robot behind the stand-in Naoqi services
+ * Each joint follows its target with a first order lag scaled by its
+ * stiffness, draws a current from its tracking error, and heats up with
+ * dT/dt = a*I^2 - b*(T - ambient). The plant is integrated lazily, in
+ * closed form, each time it is accessed. Every call of a stand-in service
+ * goes through rpc(), which adds the configured latency and failures
+ */
+class FakeRobot
+{
+public:
+  /** latency and failures added to the calls */
+  struct Faults
+  {
+    /** delay of every call and uniform jitter on top of it [s] */
+    double latency;
+    double jitter;
+
+    /** probability of a call to throw */
+    double error_rate;
+
+    /** probability of a call to hang for stall_duration [s] before answering */
+    double stall_rate;
+    double stall_duration;
+
+    /** calls that always throw, as Service.method */
+    std::set <std::string> failing;
+    /** calls that always hang for stall_duration, as Service.method */
+    std::set <std::string> stalling;
+
+    Faults();
+  };
+
+  /**
+  * @brief Constructor
+  * @param body_type[in] pepper or nao, the joints depend on it
+  * @param version[in] NAOqi version reported by ALMemory
+  */
+  FakeRobot(const std::string &body_type = "pepper",
+            const std::string &version = "2.5.0.fake");
+
+  //! @brief change the latency and the failures of the calls
+  void setFaults(const Faults &faults);
+
+  /**
+  * @brief account for a call: wait for the latency, then maybe hang or throw
+  * @param method[in] name of the call, as Service.method
+  */
+  void rpc(const std::string &method);
+
+  //! @brief body type and NAOqi version
+  const std::string& getBodyType() const;
+  const std::string& getVersion() const;
+
+  //! @brief joints of a chain, of "Body", "JointActuators" or "Joints", or the joint itself
+  std::vector <std::string> getBodyNames(const std::string &name) const;
+
+  //! @brief value of a memory key, 0 if unknown
+  float getData(const std::string &key);
+
+  //! @brief values of memory keys
+  std::vector <float> getListData(const std::vector <std::string> &keys);
+
+  //! @brief force the value of a memory key, NaN releases it
+  void setData(const std::string &key, const float &value);
+
+  //! @brief write an actuator key, Position or Hardness
+  void setActuator(const std::string &key, const float &value);
+
+  //! @brief set the targets of joints, speed being a fraction of their maximum speed
+  void setAngles(const std::vector <std::string> &names,
+                 const std::vector <float> &angles,
+                 const float &speed);
+
+  //! @brief get the angles of joints
+  std::vector <float> getAngles(const std::vector <std::string> &names,
+                                const bool &use_sensors);
+
+  //! @brief set the stiffness of joints
+  void setStiffnesses(const std::vector <std::string> &names,
+                      const std::vector <float> &stiffnesses);
+
+  //! @brief set the stiffness of all joints and their targets to the current angles
+  void setAwake(const bool &awake);
+
+  //! @brief check if the robot is awake
+  bool isAwake();
+
+  //! @brief move the base by x, y, theta in its frame
+  void moveTo(const float &x, const float &y, const float &theta);
+
+  //! @brief base position x, y, theta in the world frame
+  std::vector <float> getRobotPosition();
+
+  //! @brief base velocity x, y, theta in the robot frame
+  std::vector <float> getRobotVelocity();
+
+private:
+  /** state of a joint */
+  struct Joint
+  {
+    float position;
+    float target;
+    float velocity;
+    float max_velocity;
+    float stiffness;
+    float current;
+    float temperature;
+  };
+
+  //! @brief integrate the plant up to now, called with the mutex locked
+  void update();
+
+  //! @brief value of a memory key, called with the mutex locked
+  float readKey(const std::string &key);
+
+  //! @brief joint of a memory key, and its field in *field
+  Joint* findJoint(const std::string &key, std::string *field);
+
+  std::string body_type_;
+  std::string version_;
+
+  /** joints of the chains, of Body and of JointActuators */
+  std::map <std::string, std::vector <std::string> > chains_;
+
+  /** state of each joint */
+  std::map <std::string, Joint> joints_;
+
+  /** forced memory keys */
+  std::map <std::string, float> data_;
+
+  /** base pose, its target and velocity, x, y, theta */
+  float base_[3];
+  float base_target_[3];
+  float base_velocity_[3];
+
+  float battery_;
+  bool awake_;
+
+  /** time of the last update [ns] */
+  boost::uint64_t last_update_;
+
+  Faults faults_;
+  boost::mt19937 random_;
+
+  /** protect the plant, the faults and the random generator */
+  boost::mutex mutex_;
+};
+
+#endif // FAKE_ROBOT_HPP
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef FAKE_SERVICES_HPP
+#define FAKE_SERVICES_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+// NAOqi Headers
+#include <qi/anyobject.hpp>
+#include <qi/anyvalue.hpp>
+#include <qi/os.hpp>
+#include <qi/session.hpp>
+
+#include "naoqi_dcm_driver/fake_robot.hpp"
+
+/*
+ * Stand-in Naoqi services, registered on a local session in place of the robot.
+ * They only implement the methods the driver calls, on top of a FakeRobot
+ */
+
+/**
+ * @brief This class stands in for ALMemory
+ */
+class FakeMemory
+{
+public:
+  FakeMemory(const boost::shared_ptr <FakeRobot> &robot);
+
+  qi::AnyValue getData(const std::string &key);
+  std::vector <qi::AnyValue> getListData(const std::vector <std::string> &keys);
+  void insertData(const std::string &key, const float &value);
+  std::string version();
+  int subscribeToMicroEvent(const std::string &name, const std::string &module,
+                            const std::string &message, const std::string &method);
+  void unsubscribeToMicroEvent(const std::string &name, const std::string &module);
+
+private:
+  boost::shared_ptr <FakeRobot> robot_;
+};
+
+/**
+ * @brief This class stands in for ALMotion
+ */
+class FakeMotion
+{
+public:
+  FakeMotion(const boost::shared_ptr <FakeRobot> &robot);
+
+  std::vector <std::string> getBodyNames(const std::string &name);
+  bool robotIsWakeUp();
+  void wakeUp();
+  void rest();
+  void setAngles(const qi::AnyValue &names, const qi::AnyValue &angles, const float &speed);
+  std::vector <float> getAngles(const qi::AnyValue &names, const bool &use_sensors);
+  void stiffnessInterpolation(const qi::AnyValue &names, const qi::AnyValue &stiffnesses,
+                              const qi::AnyValue &times);
+  void setStiffnesses(const qi::AnyValue &names, const qi::AnyValue &stiffnesses);
+  void moveTo(const float &x, const float &y, const float &theta);
+  std::vector <float> getRobotPosition(const bool &use_sensors);
+  std::vector <float> getRobotVelocity();
+  void setMoveArmsEnabled(const bool &left, const bool &right);
+  void setExternalCollisionProtectionEnabled(const std::string &name, const bool &enabled);
+  void setSmartStiffnessEnabled(const bool &enabled);
+  void setPushRecoveryEnabled(const bool &enabled);
+
+private:
+  boost::shared_ptr <FakeRobot> robot_;
+};
+
+/**
+ * @brief This class stands in for DCM, the timed commands are applied at once
+ */
+class FakeDCM
+{
+public:
+  FakeDCM(const boost::shared_ptr <FakeRobot> &robot);
+
+  void createAlias(const qi::AnyValue &alias);
+  void setAlias(const qi::AnyValue &commands);
+  void set(const qi::AnyValue &command);
+  int getTime(const int &offset);
+
+private:
+  boost::shared_ptr <FakeRobot> robot_;
+
+  /** keys of each alias */
+  std::map <std::string, std::vector <std::string> > aliases_;
+
+  /** protect the aliases */
+  boost::mutex mutex_;
+
+  /** DCM time origin [us] */
+  qi::int64_t start_;
+};
+
+/**
+ * @brief This class stands in for ALBodyTemperature
+ */
+class FakeBodyTemperature
+{
+public:
+  FakeBodyTemperature(const boost::shared_ptr <FakeRobot> &robot);
+
+  void setEnableNotifications(const bool &enabled);
+
+private:
+  boost::shared_ptr <FakeRobot> robot_;
+};
+
+/**
+ * @brief This class stands in for ALTouch
+ */
+class FakeTouch
+{
+public:
+  FakeTouch(const boost::shared_ptr <FakeRobot> &robot);
+
+  void exit();
+
+private:
+  boost::shared_ptr <FakeRobot> robot_;
+};
+
+/**
+ * @brief This class stands in for ALAutonomousLife
+ */
+class FakeAutonomousLife
+{
+public:
+  FakeAutonomousLife(const boost::shared_ptr <FakeRobot> &robot);
+
+  std::string getState();
+  void setState(const std::string &state);
+
+private:
+  boost::shared_ptr <FakeRobot> robot_;
+  std::string state_;
+  boost::mutex mutex_;
+};
+
+/**
+ * @brief register ALMemory, ALMotion, DCM, ALBodyTemperature, ALTouch and
+ * ALAutonomousLife on a session, all backed by the same robot
+ * @return false if a service could not be registered
+ */
+bool registerFakeServices(const qi::SessionPtr &session,
+                          const boost::shared_ptr <FakeRobot> &robot);
+
+#endif // FAKE_SERVICES_HPP
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef FLIGHT_RECORDER_HPP
+#define FLIGHT_RECORDER_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "naoqi_dcm_driver/loop_stats.hpp"
+
+/**
+ * @brief This class keeps the last ticks and Naoqi calls in memory, to dump them on a fault
+ * The ring buffers are allocated once when the recorder is enabled, the
+ * oldest records being overwritten. Recording never locks nor allocates.
+ * The ticks are recorded by the control loop only, the calls by any thread
+ */
+class FlightRecorder
+{
+public:
+  /** values recorded per joint at each tick */
+  enum Value
+  {
+    POSITION,
+    COMMAND,
+    VELOCITY_COMMAND,
+    EFFORT,
+    VALUES
+  };
+
+  /** flags of a tick */
+  enum Flag
+  {
+    READ = 1,
+    SENT = 2
+  };
+
+  /** status of a Naoqi call */
+  enum Status
+  {
+    OK,
+    ERROR,
+    TIMEOUT
+  };
+
+  /** a tick read from a dump */
+  struct Tick
+  {
+    boost::uint64_t number;
+    boost::uint64_t time;
+    boost::uint32_t flags;
+    std::vector <boost::uint32_t> durations;
+    std::vector <float> values;
+  };
+
+  /** a Naoqi call read from a dump */
+  struct Rpc
+  {
+    std::string method;
+    boost::uint64_t start;
+    boost::uint64_t end;
+    boost::uint32_t status;
+  };
+
+  /** a dump, the times are monotonic [ns] */
+  struct Recording
+  {
+    std::string reason;
+    boost::uint64_t time;
+    boost::uint64_t ros_time;
+    std::vector <std::string> joints;
+    std::vector <std::string> stages;
+    std::vector <Tick> ticks;
+    std::vector <Rpc> rpcs;
+  };
+
+  //! @brief recorder shared by all the threads of the process
+  static FlightRecorder& instance();
+
+  /**
+  * @brief allocate the ring buffers and start recording
+  * The ticks buffer follows the joints and the number of ticks of each call,
+  * so it must not be called while the control loop records. The calls buffer
+  * is recorded by any thread, it is allocated by the first call only.
+  * @param ticks[in] number of ticks kept
+  * @param joints[in] names of the joints recorded at each tick
+  * @param rpcs[in] number of Naoqi calls kept
+  */
+  void enable(const size_t &ticks,
+              const std::vector <std::string> &joints,
+              const size_t &rpcs);
+
+  //! @brief check if the recorder is enabled
+  bool isEnabled() const
+  {
+    return enabled_.load(boost::memory_order_acquire);
+  }
+
+  /**
+  * @brief record a tick, from the control loop only
+  * @param durations[in] durations of the stages [ns], the sleep being the one before the tick
+  * @param flags[in] READ if the joints were read, SENT if the commands were sent
+  * @param positions[in] read joints positions
+  * @param commands[in] joints commands
+  * @param velocity_commands[in] joints velocity commands
+  * @param efforts[in] joints efforts (stiffness)
+  */
+  void recordTick(const boost::uint64_t *durations,
+                  const boost::uint32_t &flags,
+                  const std::vector <double> &positions,
+                  const std::vector <double> &commands,
+                  const std::vector <double> &velocity_commands,
+                  const std::vector <double> &efforts);
+
+  /**
+  * @brief record the result of a Naoqi call
+  * @param method[in] name of the method, must outlive the recorder
+  * @param start[in] issue of the call [ns]
+  * @param end[in] completion of the call [ns]
+  * @param status[in] OK, ERROR or TIMEOUT
+  */
+  void recordRpc(const std::string *method,
+                 const boost::uint64_t &start,
+                 const boost::uint64_t &end,
+                 const Status &status);
+
+  //! @brief write the recorded ticks and calls to a binary file
+  bool dump(const std::string &path, const std::string &reason);
+
+  //! @brief read a binary file written by dump
+  static bool load(const std::string &path, Recording *recording);
+
+private:
+  FlightRecorder();
+
+  /** a tick, its sequence is 0 while it is written */
+  struct TickSlot
+  {
+    boost::atomic <boost::uint64_t> sequence;
+    boost::uint64_t time;
+    boost::uint32_t flags;
+    boost::uint32_t durations[LoopStats::STAGES];
+  };
+
+  /** a Naoqi call, its sequence is 0 while it is written */
+  struct RpcSlot
+  {
+    boost::atomic <boost::uint64_t> sequence;
+    const std::string *method;
+    boost::uint64_t start;
+    boost::uint64_t end;
+    boost::uint32_t status;
+  };
+
+  /** ring buffers, the calls one is never reallocated once enabled */
+  boost::scoped_array <TickSlot> ticks_;
+  boost::scoped_array <float> values_;
+  size_t ticks_capacity_;
+  boost::scoped_array <RpcSlot> rpcs_;
+  size_t rpcs_capacity_;
+
+  /** names of the recorded joints */
+  std::vector <std::string> joints_;
+
+  /** number of ticks and calls recorded so far */
+  boost::uint64_t ticks_head_;
+  boost::atomic <boost::uint64_t> rpcs_head_;
+
+  boost::atomic <bool> enabled_;
+
+  /** serialize the dumps */
+  boost::mutex mutex_;
+};
+
+#endif // FLIGHT_RECORDER_HPP
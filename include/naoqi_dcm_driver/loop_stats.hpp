@@ -0,0 +1,102 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef LOOP_STATS_HPP
+#define LOOP_STATS_HPP
+
+#include <boost/cstdint.hpp>
+
+#include <std_msgs/Float32MultiArray.h>
+
+#include "naoqi_dcm_driver/rpc_stats.hpp"
+
+/**
+ * @brief This class times the stages of the control loop
+ * Each stage is the time since the previous mark, the tick is the time
+ * between two starts. A tick overruns when its stages, without the sleep,
+ * exceed the period; the overrun is then blamed on its slowest stage.
+ * The stages are also traced when the Tracer is enabled, and each tick
+ * fires the static probe tick(number, dt [ns]).
+ * It is used by the control loop thread only
+ */
+class LoopStats
+{
+public:
+  /** stages of the control loop, in the order they run */
+  enum Stage
+  {
+    ODOMETRY,
+    DIAGNOSTICS,
+    READ,
+    UPDATE,
+    WRITE,
+    STIFFNESS,
+    STATISTICS,
+    JOINT_STATES,
+    SENSORS,
+    SLEEP,
+    STAGES
+  };
+
+  /**
+  * @brief Constructor
+  * @param period[in] period of the control loop [s]
+  */
+  LoopStats(const double &period = 0.01);
+
+  //! @brief start a tick, the time since the last mark is the sleep
+  void startTick();
+
+  //! @brief end a stage, the time since the last mark is its duration
+  void mark(const Stage &stage);
+
+  //! @brief durations of the stages of the current tick and of the sleep before it [ns]
+  const boost::uint64_t* getDurations() const;
+
+  //! @brief name of a stage
+  static const char* getStageName(const Stage &stage);
+
+  //! @brief forget the current tick, its sleep is not recorded (loop frozen)
+  void cancelTick();
+
+  //! @brief fill one row per stage and one for the tick, then restart the window
+  void fill(std_msgs::Float32MultiArray *msg);
+
+private:
+  /** period of the control loop [ns] */
+  boost::uint64_t budget_;
+
+  /** start of the current tick and time of the last mark [ns], 0 if none */
+  boost::uint64_t tick_start_;
+  boost::uint64_t last_mark_;
+
+  /** ticks started so far */
+  boost::uint64_t ticks_;
+
+  /** durations of the stages of the current tick [ns] */
+  boost::uint64_t durations_[STAGES];
+
+  /** histograms since the last fill */
+  LatencyHistogram stages_[STAGES];
+  LatencyHistogram tick_;
+
+  /** overruns since the last fill, per slowest stage and in total */
+  boost::uint64_t overruns_[STAGES];
+  boost::uint64_t tick_overruns_;
+};
+
+#endif // LOOP_STATS_HPP
@@ -18,32 +18,67 @@
 #ifndef MEMORY_HPP
 #define MEMORY_HPP
 
+#include <map>
+#include <vector>
+
 // NAOqi Headers
 #include <qi/session.hpp>
 
+#include "naoqi_dcm_driver/rpc_proxy.hpp"
+
 /**
  * @brief This class is a wapper for Naoqi Memory Class
  */
 class Memory
 {
 public:
-  Memory(const qi::SessionPtr& session);
+  Memory(const qi::AnyObject& proxy);
 
   //! @brief initialize with joints names to control
   void init(const std::vector <std::string> &joints_names);
 
+  //! @brief use a new Memory proxy, the keys groups are kept
+  void setProxy(const qi::AnyObject& proxy);
+
+  //! @brief set the subset of the initialized joints to read
+  void setJoints(const std::vector <std::string> &joints_names);
+
   //! @brief initialize memory keys to read
   std::vector <std::string> initMemoryKeys(const std::vector <std::string> &joints);
 
   //! @brief Get values of keys
   std::vector<float> getListData();
 
+  /**
+  * @brief add a group of keys to the batched read
+  * @param keys[in] keys of the group
+  * @param decimation[in] read the group every decimation ticks, never if 0
+  * @return the group id
+  */
+  int addKeysGroup(const std::vector <std::string> &keys,
+                   const int &decimation=1);
+
+  //! @brief replace the keys of a group
+  void setKeysGroup(const int &id, const std::vector <std::string> &keys);
+
+  //! @brief read the keys of all groups due at this tick in one request
+  bool update();
+
+  //! @brief check if a group was read by the last update
+  bool isKeysGroupUpdated(const int &id) const;
+
+  //! @brief get the values of a group read by the last update
+  const float* getKeysGroupData(const int &id) const;
+
   //! @brief Get values associated with the given list of keys
   std::vector<float> getListData(const std::vector <std::string> &keys);
 
   //! @brief get a key-value pair stored in memory
   std::string getData(const std::string &str);
 
+  //! @brief request a key-value pair stored in memory, without waiting for it
+  qi::Future <std::string> getDataAsync(const std::string &str);
+
   //! @brief subscribe to a micro-event
   void subscribeToMicroEvent(const std::string &name,
                              const std::string &callback_module,
@@ -56,10 +91,34 @@ public:
 
 private:
   /** Memory proxy */
-  qi::AnyObject memory_proxy_;
+  RpcProxy memory_proxy_;
+
+  /** group of keys read together */
+  struct KeysGroup
+  {
+    std::vector <std::string> keys;
+    int decimation;
+    bool updated;
+    size_t offset;
+  };
+
+  /** groups of keys, the first one being the joints positions */
+  std::vector <KeysGroup> groups_;
+
+  /** keys read at each combination of due groups */
+  std::map <std::vector <bool>, std::vector <std::string> > keys_cache_;
+
+  /** groups due at this tick */
+  std::vector <bool> due_;
+
+  /** values read by the last update */
+  std::vector <float> values_;
+
+  /** number of updates */
+  unsigned long tick_;
 
-  /** joints positions keys to read */
-  std::vector <std::string> keys_positions_;
+  /** joints positions keys of all initialized joints */
+  std::map <std::string, std::string> keys_all_;
 };
 
 #endif // MEMORY_HPP
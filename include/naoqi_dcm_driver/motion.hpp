@@ -21,13 +21,21 @@
 // NAOqi Headers
 #include <qi/session.hpp>
 
+#include "naoqi_dcm_driver/rpc_proxy.hpp"
+
 /**
  * @brief This class is a wapper for Naoqi Motion Class
  */
 class Motion
 {
 public:
-  Motion(const qi::SessionPtr& session);
+  Motion(const qi::AnyObject& proxy);
+
+  //! @brief configure walk arms, collision protection and smart stiffness, without waiting
+  std::vector <qi::Future <void> > configure();
+
+  //! @brief use a new Motion proxy, pending requests are dropped
+  void setProxy(const qi::AnyObject& proxy);
 
   //! @brief initialize with joints names to control
   void init(const std::vector <std::string> &joints_names);
@@ -44,6 +52,9 @@ public:
   //! @brief get body names
   std::vector <std::string> getBodyNames(const std::string &robot_part);
 
+  //! @brief request body names, without waiting for them
+  qi::Future <std::vector <std::string> > getBodyNamesAsync(const std::string &robot_part);
+
   //! @brief get body names based on motor groups
   std::vector <std::string> getBodyNamesFromGroup(const std::vector<std::string> &motor_groups);
 
@@ -53,6 +64,12 @@ public:
   //! @brief Move the robot at given velocity and angle
   void moveTo(const float& vel_x, const float& vel_y, const float& vel_th);
 
+  //! @brief request the robot position and velocity, without waiting for them
+  void requestOdometry();
+
+  //! @brief get the requested robot position and velocity, if received
+  bool getOdometry(std::vector <float> *position, std::vector <float> *velocity);
+
   //! @brief get joints angles
   std::vector<double> getAngles(const std::string &robot_part);
 
@@ -69,15 +86,25 @@ public:
                               const float &stiffness,
                               const float &time);
 
+  //! @brief set stiffness for each joint immediately
+  bool setStiffnesses(const std::vector<std::string> &joints,
+                      const std::vector<float> &stiffnesses);
+
   //! @brief set stiffness for arms
   bool setStiffnessArms(const float &stiffness, const float &time);
 
 private:
   /** Motion proxy */
-  qi::AnyObject motion_proxy_;
+  RpcProxy motion_proxy_;
 
   /** joints names */
   std::vector <std::string> joints_names_;
+
+  /** requested robot position */
+  qi::Future <std::vector <float> > position_future_;
+
+  /** requested robot velocity */
+  qi::Future <std::vector <float> > velocity_future_;
 };
 
 #endif // MOTION_HPP
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef PROBES_HPP
+#define PROBES_HPP
+
+/**
+ * Static probes of the provider naoqi_dcm_driver, listed by
+ * "readelf -n" and attached with bpftrace or SystemTap, e.g.
+ * bpftrace -e 'usdt:./libnaoqi_dcm_driver_nodelet.so:naoqi_dcm_driver:tick { @dt = hist(arg1); }'
+ * A probe is a single nop until attached. Without sys/sdt.h, they are compiled out
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define NAOQI_DCM_PROBE(name) DTRACE_PROBE(naoqi_dcm_driver, name)
+#define NAOQI_DCM_PROBE2(name, arg1, arg2) DTRACE_PROBE2(naoqi_dcm_driver, name, arg1, arg2)
+
+/** fire name_entry now and name_exit when leaving the scope, whatever the return path */
+#define NAOQI_DCM_PROBE_SCOPE(name) \
+  NAOQI_DCM_PROBE(name##_entry); \
+  struct ProbeExit_##name \
+  { \
+    ~ProbeExit_##name() { NAOQI_DCM_PROBE(name##_exit); } \
+  } probe_exit_##name
+
+#else
+
+#define NAOQI_DCM_PROBE(name) do {} while (0)
+#define NAOQI_DCM_PROBE2(name, arg1, arg2) do {} while (0)
+#define NAOQI_DCM_PROBE_SCOPE(name) do {} while (0)
+
+#endif
+
+#endif // PROBES_HPP
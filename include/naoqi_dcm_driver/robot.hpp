@@ -18,8 +18,16 @@
 #ifndef NAOQI_DCM_DRIVER_H
 #define NAOQI_DCM_DRIVER_H
 
+#include <list>
+#include <map>
+#include <set>
+
 // Boost Headers
+#include <boost/atomic.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread.hpp>
 
 // NAOqi Headers
 #include <qi/session.hpp>
@@ -34,14 +42,14 @@
 #include <sensor_msgs/Imu.h>
 #include <sensor_msgs/Range.h>
 #include <sensor_msgs/JointState.h>
-#include <std_msgs/Float32.h>
+#include <nav_msgs/Odometry.h>
 
 #include <tf/transform_broadcaster.h>
-#include <tf/transform_listener.h>
 #include <tf/transform_datatypes.h>
 
 #include <hardware_interface/joint_command_interface.h>
 #include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/posvel_command_interface.h>
 #include <hardware_interface/robot_hw.h>
 
 #include <controller_manager/controller_manager.h>
@@ -49,21 +57,32 @@
 #include "naoqi_dcm_driver/diagnostics.hpp"
 #include "naoqi_dcm_driver/memory.hpp"
 #include "naoqi_dcm_driver/dcm.hpp"
+#include "naoqi_dcm_driver/loop_stats.hpp"
 #include "naoqi_dcm_driver/motion.hpp"
+#include "naoqi_dcm_driver/sensors.hpp"
+#include "naoqi_dcm_driver/supervisor.hpp"
+#include "naoqi_dcm_driver/topology_cache.hpp"
 
 template<typename T, size_t N>
 T * end(T (&ra)[N]) {
     return ra + N;
 }
 
-class Robot : public hardware_interface::RobotHW
+class Robot : public hardware_interface::RobotHW,
+              public boost::enable_shared_from_this<Robot>
 {
 public:
   /**
   * @brief Constructor
   * @param session[in] session pointer for the service registration
+  * @param nh[in] node handle for topics
+  * @param pnh[in] node handle for parameters
+  * @param shutdown_ros[in] shutdown ROS when stopping the service (standalone node)
   */
-  Robot(qi::SessionPtr session);
+  Robot(qi::SessionPtr session,
+        const ros::NodeHandle &nh=ros::NodeHandle(""),
+        const ros::NodeHandle &pnh=ros::NodeHandle("~"),
+        const bool &shutdown_ros=true);
 
   //! @brief destroy all ros nodehandle and shutsdown all publisher
   ~Robot();
@@ -77,9 +96,29 @@ public:
   //! @brief connect to ALProxies
   bool connect();
 
+  //! @brief register the service on the session
+  bool registerService();
+
+  //! @brief latency and failures of the Naoqi calls per method, latencies in us
+  std::map <std::string, std::map <std::string, double> > getStats();
+
+  //! @brief write the recorded spans as Chrome Trace Event JSON, to trace_path_ if path is empty
+  bool dumpTrace(const std::string &path);
+
   //! @brief start the main loop
   void run();
 
+  //! @brief make the main loop return at its next tick, from another thread
+  void stopLoop();
+
+  //! @brief check the joints claimed by the controllers to start
+  bool prepareSwitch(const std::list<hardware_interface::ControllerInfo> &start_list,
+                     const std::list<hardware_interface::ControllerInfo> &stop_list);
+
+  //! @brief restrict reading and writing to the joints claimed by running controllers
+  void doSwitch(const std::list<hardware_interface::ControllerInfo> &start_list,
+                const std::list<hardware_interface::ControllerInfo> &stop_list);
+
 private:
   //! @brief initialize controllers based on joints names
   bool initializeControllers(const std::vector <std::string> &joints_names);
@@ -90,14 +129,41 @@ private:
   //! @brief load parameters
   bool loadParams();
 
+  //! @brief request all services at once and wait for them, missing ones are left out
+  std::map <std::string, qi::AnyObject> resolveServices(const std::vector <std::string> &names);
+
+  //! @brief services required to control the robot
+  std::vector <std::string> getRequiredServices();
+
+  //! @brief freeze the loop and start reconnecting in the background
+  void onDisconnected(const std::string &reason);
+
+  //! @brief keep the values of this tick in the flight recorder
+  void recordTick();
+
+  //! @brief write the flight recorder to a new file of flight_recorder_directory_
+  void dumpFlightRecorder(const std::string &reason);
+
+  //! @brief reconnect the session and resolve the required services (reconnect thread)
+  void reconnect();
+
+  //! @brief swap the reconnected proxies in, return false while the session is lost
+  bool resume();
+
   //! @brief the main loop
   void controllerLoop();
 
   //! @brief control the robot's velocity
   void commandVelocity(const geometry_msgs::TwistConstPtr &msg);
 
-  //! @brief publish the base_footprint
-  void publishBaseFootprint(const ros::Time &ts);
+  //! @brief publish the odometry and the odom to base_footprint transform
+  void publishOdometry(const ros::Time &ts);
+
+  //! @brief resolve the odometry frames and preallocate its messages
+  void initOdometry();
+
+  //! @brief scale down the stiffness of the joints forced by the diagnostics, and back up once released
+  void updateDerating();
 
   //! @brief check HW and Naoqi joints names
   std::vector <bool> checkJoints();
@@ -105,8 +171,11 @@ private:
   //! @brief read joints values
   void readJoints();
 
-  //! @brief publish joint states
-  void publishJointStateFromAlMotion();
+  //! @brief publish joint states from the values read at this tick
+  void publishJointStates(const ros::Time &ts);
+
+  //! @brief map the joint states to the memory keys read
+  void updateJointStatesKeys();
 
   //! @brief set joints values
   void writeJoints();
@@ -114,12 +183,36 @@ private:
   //! @brief set stiffness
   bool setStiffness(const float &stiffness);
 
+  //! @brief apply the joints stiffness changed by effort commands
+  void writeStiffness();
+
+  //! @brief publish the applied stiffness when it changes or for the heartbeat
+  void publishStiffness(const ros::Time &ts);
+
+  //! @brief publish the Naoqi calls statistics every rpc_stats_period_
+  void publishRpcStats(const ros::Time &ts);
+
+  //! @brief publish the control loop timings every loop_stats_period_
+  void publishLoopStats(const ros::Time &ts);
+
+  //! @brief update the joints to read and to write, outside of the controllers update
+  void updateActiveJoints();
+
+  //! @brief read the angles of the given joints, or of all joints, that are not read at each tick
+  void refreshAngles(const std::set<std::string> &joints, const bool &all);
+
   //! @brief ignore mimic joints from control
   void ignoreMimicJoints(std::vector <std::string> *joints);
 
   /** node handle pointer*/
   boost::scoped_ptr <ros::NodeHandle> nhPtr_;
 
+  /** private node handle for parameters */
+  ros::NodeHandle pnh_;
+
+  /** shutdown ROS when stopping the service */
+  bool shutdown_ros_;
+
   /** pointer to Diagnostics class */
   boost::shared_ptr <Diagnostics> diagnostics_;
 
@@ -132,29 +225,131 @@ private:
   /** pointer to Motion class */
   boost::shared_ptr <Motion> motion_;
 
+  /** pointer to Sensors class */
+  boost::shared_ptr <Sensors> sensors_;
+
+  /** pointer to Supervisor class */
+  boost::shared_ptr <Supervisor> supervisor_;
+
+  /** pointer to TopologyCache class */
+  boost::shared_ptr <TopologyCache> topology_cache_;
+
+  /** topology cache file, disabled if empty */
+  std::string topology_cache_path_;
+
   /** subscrier to MoveTo */
   ros::Subscriber cmd_moveto_sub_;
 
   /** base_footprint broadcaster */
   tf::TransformBroadcaster base_footprint_broadcaster_;
 
-  /** base_footprint listener */
-  tf::TransformListener base_footprint_listener_;
+  /** odometry publisher */
+  ros::Publisher odom_pub_;
+
+  /** odometry data */
+  boost::shared_ptr <nav_msgs::Odometry> odom_;
+
+  /** odom to base_footprint transform */
+  geometry_msgs::TransformStamped odom_tf_;
+
+  /** robot position and velocity received from ALMotion */
+  std::vector <float> odom_position_;
+  std::vector <float> odom_velocity_;
+
+  /** publish the odometry every odom_decimation_ loops, never if 0 */
+  int odom_decimation_;
+
+  /** loops since the last odometry request */
+  int odom_count_;
 
   /** stiffness publisher */
   ros::Publisher stiffness_pub_;
 
+  /** Naoqi calls statistics publisher */
+  ros::Publisher rpc_stats_pub_;
+
+  /** Naoqi calls statistics, copied on write when still used by subscribers */
+  boost::shared_ptr <diagnostic_msgs::DiagnosticArray> rpc_stats_;
+
+  /** period of the Naoqi calls statistics, never published if 0 */
+  double rpc_stats_period_;
+
+  /** deadline of the Naoqi calls, the longer ones are counted as timeouts [s] */
+  double rpc_timeout_;
+
+  /** control loop timings */
+  boost::scoped_ptr <LoopStats> loop_stats_;
+
+  /** control loop timings publisher */
+  ros::Publisher loop_stats_pub_;
+
+  /** control loop timings, copied on write when still used by subscribers */
+  boost::shared_ptr <std_msgs::Float32MultiArray> loop_stats_msg_;
+
+  /** period of the control loop timings, never published if 0 */
+  double loop_stats_period_;
+
+  /** last time the control loop timings were published */
+  ros::Time loop_stats_last_;
+
   /** diagnostics publisher */
   ros::Publisher diag_pub_;
 
+  /** joints statistics publisher */
+  ros::Publisher joint_stats_pub_;
+
   /** joint states publisher */
   ros::Publisher joint_states_pub_;
 
-  /** stiffness data */
-  std_msgs::Float32 stiffness_;
+  /** clamped commands publisher */
+  ros::Publisher clamps_pub_;
+
+  /** clamped commands, copied on write when still used by subscribers */
+  boost::shared_ptr <diagnostic_msgs::DiagnosticArray> clamps_;
+
+  /** applied stiffness of Naoqi controlled joints, in efforts */
+  boost::shared_ptr <sensor_msgs::JointState> stiffness_;
 
-  /** joint states data */
-  sensor_msgs::JointState joint_states_topic_;
+  /** the applied stiffness changed since the last publication */
+  bool stiffness_changed_;
+
+  /** maximum duration between stiffness publications */
+  double stiffness_heartbeat_;
+
+  /** index of each HW joint in the diagnostics joints, -1 if none */
+  std::vector <int> hw_diagnostics_index_;
+
+  /** stiffness scale of each HW joint, lowered while its joint is forced */
+  std::vector <double> hw_derating_;
+
+  /** lowest stiffness scale of a forced joint */
+  double derating_stiffness_;
+
+  /** speed of the stiffness scale changes [1/s] */
+  double derating_rate_;
+
+  /** Naoqi joints stiffness to apply */
+  std::vector <std::string> qi_stiffness_joints_;
+  std::vector <float> qi_stiffness_commands_;
+
+  /** joint states data, copied on write when still used by subscribers */
+  boost::shared_ptr <sensor_msgs::JointState> joint_states_topic_;
+
+  /** memory keys group of the joint states not read for control */
+  int joint_states_group_;
+
+  /** publish joint states every joint_states_decimation_ loops, never if 0 */
+  int joint_states_decimation_;
+
+  /** joint states sources: index in the read joints if >= 0,
+   * else -(index+1) in the joint states keys group */
+  std::vector <int> joint_states_sources_;
+
+  /** joint states read as speeds (wheels) */
+  std::vector <bool> joint_states_wheels_;
+
+  /** index of the joints electric currents, published as efforts, in the joint states keys group */
+  int joint_states_currents_;
 
   /** controller manager */
   controller_manager::ControllerManager* manager_;
@@ -162,8 +357,11 @@ private:
   /** service name */
   std::string session_name_;
 
-  /** session connection status */
-  bool is_connected_;
+  /** session connection status, read by the session signals too */
+  boost::atomic <bool> is_connected_;
+
+  /** the main loop is requested to return */
+  boost::atomic <bool> loop_stopping_;
 
   /** robot body type */
   std::string body_type_;
@@ -189,6 +387,66 @@ private:
   /** Naoqi session pointer */
   qi::SessionPtr _session;
 
+  /** session url to reconnect to */
+  std::string session_url_;
+
+  /** link to the session disconnected signal */
+  qi::SignalLink disconnected_link_;
+
+  /** protect the reconnection state shared with the reconnect thread */
+  boost::mutex reconnect_mutex_;
+
+  /** the session is lost, the loop is frozen */
+  bool session_lost_;
+
+  /** the reconnect thread is running */
+  bool reconnecting_;
+
+  /** reason of a flight recorder dump requested by the session signals, done by the loop */
+  std::string pending_dump_;
+
+  /** the services resolved by the reconnect thread, empty until it succeeds */
+  std::map <std::string, qi::AnyObject> reconnect_services_;
+
+  /** reconnect thread */
+  boost::thread reconnect_thread_;
+
+  /** period between two reconnection attempts */
+  double reconnect_period_;
+
+  /** time of the session loss */
+  ros::WallTime session_lost_time_;
+
+  /** restart the running controllers at the next update */
+  bool reset_controllers_;
+
+  /** the controllers switched, the joints to read and to write are updated at the next tick */
+  bool active_joints_changed_;
+
+  /** record the spans of the control loop and of the Naoqi calls */
+  bool trace_enabled_;
+
+  /** number of spans kept by the tracer */
+  int trace_capacity_;
+
+  /** file the trace is written to when stopping the service */
+  std::string trace_path_;
+
+  /** seconds kept by the flight recorder, disabled if 0 */
+  double flight_recorder_duration_;
+
+  /** number of Naoqi calls kept by the flight recorder */
+  int flight_recorder_rpcs_;
+
+  /** directory of the flight recorder dumps */
+  std::string flight_recorder_directory_;
+
+  /** reason of the next stop, reported by the flight recorder */
+  std::string stop_reason_;
+
+  /** the commands were sent at this tick */
+  bool commands_sent_;
+
   /** motor groups used to control */
   std::vector <std::string> motor_groups_;
 
@@ -198,6 +456,12 @@ private:
   /** joints positions from ROS hardware interface */
   hardware_interface::PositionJointInterface jnt_pos_interface_;
 
+  /** joints velocities from ROS hardware interface */
+  hardware_interface::VelocityJointInterface jnt_vel_interface_;
+
+  /** joints positions and velocities from ROS hardware interface */
+  hardware_interface::PosVelJointInterface jnt_posvel_interface_;
+
   /** joints efforts from ROS hardware interface */ // Mainly to set stiffness
   hardware_interface::EffortJointInterface jnt_eff_interface_;
 
@@ -207,15 +471,42 @@ private:
   /** Naoqi joints angles to apply */
   std::vector <double> qi_commands_;
 
+  /** Naoqi joints velocities to apply */
+  std::vector <double> qi_vel_commands_;
+
   /** hardware interface joints names */
   std::vector <std::string> hw_joints_;
 
   /** hardware interface enabled joints */
   std::vector <bool> hw_enabled_;
 
+  /** hardware interface joints claimed by running controllers */
+  std::vector <bool> hw_claimed_;
+
+  /** hardware interface joints read from Naoqi */
+  std::vector <bool> hw_read_;
+
+  /** hardware interface joints not read since they were added to the read set */
+  std::vector <bool> hw_fresh_;
+
+  /** Naoqi joints read at each loop */
+  std::vector <std::string> qi_read_joints_;
+
+  /** Naoqi joints written at each loop */
+  std::vector <std::string> qi_write_joints_;
+
+  /** joints claimed by each running controller */
+  std::map <std::string, std::vector <std::string> > controllers_joints_;
+
+  /** running controllers reading the joints states */
+  std::set <std::string> controllers_states_;
+
   /** hardware interface joints angles to apply */
   std::vector <double> hw_commands_;
 
+  /** hardware interface joints velocities to apply */
+  std::vector <double> hw_vel_commands_;
+
   /** hardware interface current joints angles */
   std::vector <double> hw_angles_;
 
@@ -228,6 +519,9 @@ private:
   /** enable using DCM instead of ALMotion */
   bool use_dcm_;
 
+  /** enable limiting the commands */
+  bool use_supervisor_;
+
   /** stiffness value to apply */
   float stiffness_value_;
 };
@@ -0,0 +1,207 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef RPC_PROXY_HPP
+#define RPC_PROXY_HPP
+
+#include <exception>
+#include <string>
+
+#include <boost/bind.hpp>
+
+// NAOqi Headers
+#include <qi/anyobject.hpp>
+
+#include "naoqi_dcm_driver/flight_recorder.hpp"
+#include "naoqi_dcm_driver/rpc_stats.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+#include "naoqi_dcm_driver/tracer.hpp"
+
+/**
+ * @brief This class times the calls of a Naoqi proxy
+ * Every call goes through it, so that RpcStats records the latency of each
+ * method, and counts the errors and the calls canceled or longer than the
+ * RpcStats timeout. The methods are resolved once by the callers, e.g.
+ *   static RpcStats::Method *const get_data_rpc = RpcStats::instance().get("getData");
+ *   proxy.call<std::string>(get_data_rpc, key);
+ * The calls are also traced when the Tracer is enabled, and kept by the FlightRecorder
+ */
+class RpcProxy
+{
+public:
+  RpcProxy(const qi::AnyObject &object = qi::AnyObject()):
+    object_(object)
+  {
+  }
+
+  //! @brief the proxied object
+  const qi::AnyObject& object() const
+  {
+    return object_;
+  }
+
+  template <typename R>
+  R call(RpcStats::Method *method)
+  {
+    Timer timer(method);
+    return object_.call<R>(method->name);
+  }
+
+  template <typename R, typename A1>
+  R call(RpcStats::Method *method, const A1 &a1)
+  {
+    Timer timer(method);
+    return object_.call<R>(method->name, a1);
+  }
+
+  template <typename R, typename A1, typename A2>
+  R call(RpcStats::Method *method, const A1 &a1, const A2 &a2)
+  {
+    Timer timer(method);
+    return object_.call<R>(method->name, a1, a2);
+  }
+
+  template <typename R, typename A1, typename A2, typename A3>
+  R call(RpcStats::Method *method, const A1 &a1, const A2 &a2, const A3 &a3)
+  {
+    Timer timer(method);
+    return object_.call<R>(method->name, a1, a2, a3);
+  }
+
+  template <typename R, typename A1, typename A2, typename A3, typename A4>
+  R call(RpcStats::Method *method, const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4)
+  {
+    Timer timer(method);
+    return object_.call<R>(method->name, a1, a2, a3, a4);
+  }
+
+  template <typename R>
+  qi::Future<R> async(RpcStats::Method *method)
+  {
+    const boost::uint64_t start = monotonicNs();
+    return track(method, start, object_.async<R>(method->name));
+  }
+
+  template <typename R, typename A1>
+  qi::Future<R> async(RpcStats::Method *method, const A1 &a1)
+  {
+    const boost::uint64_t start = monotonicNs();
+    return track(method, start, object_.async<R>(method->name, a1));
+  }
+
+  template <typename R, typename A1, typename A2>
+  qi::Future<R> async(RpcStats::Method *method, const A1 &a1, const A2 &a2)
+  {
+    const boost::uint64_t start = monotonicNs();
+    return track(method, start, object_.async<R>(method->name, a1, a2));
+  }
+
+  template <typename R, typename A1, typename A2, typename A3>
+  qi::Future<R> async(RpcStats::Method *method, const A1 &a1, const A2 &a2, const A3 &a3)
+  {
+    const boost::uint64_t start = monotonicNs();
+    return track(method, start, object_.async<R>(method->name, a1, a2, a3));
+  }
+
+  /**
+  * @brief wait for an asynchronous call until a deadline, and cancel it if it is still running
+  * @param deadline[in] monotonic time of the deadline [ns], see monotonicNs()
+  * @return the state of the future, running if the deadline is passed
+  */
+  template <typename R>
+  static qi::FutureState wait(qi::Future<R> future, const boost::uint64_t &deadline)
+  {
+    const boost::uint64_t now = monotonicNs();
+    const int timeout_ms = (deadline > now) ? static_cast<int>((deadline - now)/1000000) : 0;
+    const qi::FutureState state = future.wait(timeout_ms);
+    if (state == qi::FutureState_Running)
+      future.cancel();
+    return state;
+  }
+
+private:
+  /** record a synchronous call when leaving its scope, as an error if it throws */
+  class Timer
+  {
+  public:
+    Timer(RpcStats::Method *method):
+      stats_(method),
+      start_(monotonicNs())
+    {
+    }
+
+    ~Timer()
+    {
+      const boost::uint64_t end = monotonicNs();
+      stats_->latency.record(end - start_);
+      Tracer::instance().record("rpc", stats_->name.c_str(), start_, end);
+      FlightRecorder::Status status = FlightRecorder::OK;
+      if (std::uncaught_exception())
+      {
+        stats_->errors.fetch_add(1, boost::memory_order_relaxed);
+        status = FlightRecorder::ERROR;
+      }
+      else if (end - start_ > RpcStats::instance().getTimeout())
+      {
+        stats_->timeouts.fetch_add(1, boost::memory_order_relaxed);
+        status = FlightRecorder::TIMEOUT;
+      }
+      FlightRecorder::instance().recordRpc(&stats_->name, start_, end, status);
+    }
+
+  private:
+    RpcStats::Method *stats_;
+    boost::uint64_t start_;
+  };
+
+  //! @brief record an asynchronous call when it finishes
+  template <typename R>
+  static void onFinished(const qi::Future<R> &future,
+                         RpcStats::Method *stats,
+                         const boost::uint64_t &start)
+  {
+    const boost::uint64_t end = monotonicNs();
+    stats->latency.record(end - start);
+    Tracer::instance().record("rpc", stats->name.c_str(), start, end, true);
+    FlightRecorder::Status status = FlightRecorder::OK;
+    if (future.isCanceled() || (end - start > RpcStats::instance().getTimeout()))
+    {
+      stats->timeouts.fetch_add(1, boost::memory_order_relaxed);
+      status = FlightRecorder::TIMEOUT;
+    }
+    else if (future.hasError(0))
+    {
+      stats->errors.fetch_add(1, boost::memory_order_relaxed);
+      status = FlightRecorder::ERROR;
+    }
+    FlightRecorder::instance().recordRpc(&stats->name, start, end, status);
+  }
+
+  template <typename R>
+  static qi::Future<R> track(RpcStats::Method *method,
+                             const boost::uint64_t &start,
+                             qi::Future<R> future)
+  {
+    future.connect(boost::bind(&RpcProxy::onFinished<R>, _1, method, start));
+    return future;
+  }
+
+  /** proxied object */
+  qi::AnyObject object_;
+};
+
+#endif // RPC_PROXY_HPP
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef RPC_STATS_HPP
+#define RPC_STATS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+/**
+ * @brief This class is a latency histogram with log-linear buckets
+ * Values below 16 have their own bucket, then each power of two is split
+ * in 16 buckets, so a percentile is within about 6% of the recorded value.
+ * Recording only uses atomic increments, it never locks
+ */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  //! @brief record a value [ns]
+  void record(const boost::uint64_t &value);
+
+  //! @brief number of recorded values
+  boost::uint64_t getCount() const;
+
+  //! @brief mean of the recorded values [ns]
+  double getMean() const;
+
+  //! @brief highest recorded value [ns]
+  boost::uint64_t getMax() const;
+
+  //! @brief value below which the ratio q of the recorded values are [ns]
+  boost::uint64_t getPercentile(const double &q) const;
+
+  //! @brief forget the recorded values
+  void reset();
+
+private:
+  //! @brief bucket of a value
+  static int getBucket(const boost::uint64_t &value);
+
+  //! @brief middle value of a bucket
+  static boost::uint64_t getBucketValue(const int &bucket);
+
+  /** number of buckets, values beyond 2^40 ns are saturated */
+  static const int BUCKETS = 16 + 37*16;
+
+  boost::atomic <boost::uint64_t> buckets_[BUCKETS];
+  boost::atomic <boost::uint64_t> count_;
+  boost::atomic <boost::uint64_t> sum_;
+  boost::atomic <boost::uint64_t> max_;
+};
+
+/**
+ * @brief This class gathers the statistics of the Naoqi calls per method name
+ */
+class RpcStats
+{
+public:
+  /** statistics of a method */
+  struct Method
+  {
+    /** name of the method, it never moves */
+    std::string name;
+    LatencyHistogram latency;
+    boost::atomic <boost::uint64_t> errors;
+    boost::atomic <boost::uint64_t> timeouts;
+    Method();
+  };
+
+  //! @brief statistics shared by all the proxies of the process
+  static RpcStats& instance();
+
+  //! @brief statistics of a method, created on first use and never destroyed
+  Method* get(const std::string &method);
+
+  /**
+  * @brief summarize each method: calls, errors, timeouts, and the
+  * mean, p50, p90, p99 and max latencies [us]
+  */
+  std::map <std::string, std::map <std::string, double> > getSummary();
+
+  //! @brief fill one status per method, keeping the message allocations
+  void fill(diagnostic_msgs::DiagnosticArray *msg);
+
+  //! @brief set the deadline of the calls, longer calls are counted as timeouts [s]
+  void setTimeout(const double &timeout);
+
+  //! @brief deadline of the calls [ns]
+  boost::uint64_t getTimeout() const;
+
+private:
+  RpcStats();
+
+  //! @brief the methods, they are never destroyed
+  std::vector <Method*> getMethods();
+
+  /** protect the methods map, not the statistics themselves */
+  boost::mutex mutex_;
+
+  /** statistics per method name */
+  std::map <std::string, boost::shared_ptr <Method> > methods_;
+
+  /** deadline of the calls [ns] */
+  boost::atomic <boost::uint64_t> timeout_;
+};
+
+#endif // RPC_STATS_HPP
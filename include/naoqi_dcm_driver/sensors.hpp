@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SENSORS_HPP
+#define SENSORS_HPP
+
+// Boost Headers
+#include <boost/shared_ptr.hpp>
+
+// ROS Headers
+#include <ros/ros.h>
+
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/Range.h>
+
+#include "naoqi_dcm_driver/memory.hpp"
+
+/**
+ * @brief This class publishes the robot sensors
+ * Their keys are read with the joints in the Memory batched request
+ */
+class Sensors
+{
+public:
+  /**
+  * @brief Constructor
+  * @param memory[in] Memory wrapper reading the keys
+  * @param nh[in] node handle for topics
+  * @param pnh[in] node handle for parameters
+  * @param prefix[in] prefix for published topics
+  * @param topic_queue[in] message buffer
+  * @param robot[in] robot type
+  */
+  Sensors(const boost::shared_ptr<Memory> &memory,
+          ros::NodeHandle *nh,
+          const ros::NodeHandle &pnh,
+          const std::string &prefix,
+          const int &topic_queue,
+          const std::string &robot);
+
+  //! @brief add the sensors keys to the batched read and advertise topics
+  void init();
+
+  //! @brief publish the sensors read at this tick
+  void publish(const ros::Time &ts);
+
+private:
+  //! @brief publish the inertial unit
+  void publishImu(const ros::Time &ts);
+
+  //! @brief publish the sonars
+  void publishSonars(const ros::Time &ts);
+
+  //! @brief publish the laser segments as a scan
+  void publishLaser(const ros::Time &ts);
+
+  //! @brief add the sonars keys and advertise their topics
+  void initSonars();
+
+  //! @brief add the laser keys and advertise its topic
+  void initLaser();
+
+  /** Memory wrapper */
+  boost::shared_ptr <Memory> memory_;
+
+  /** node handle for topics */
+  ros::NodeHandle *nh_;
+
+  /** node handle for parameters */
+  ros::NodeHandle pnh_;
+
+  /** prefix for published topics */
+  std::string prefix_;
+
+  /** message buffer */
+  int topic_queue_;
+
+  /** robot type */
+  std::string robot_;
+
+  /** inertial unit publisher */
+  ros::Publisher imu_pub_;
+
+  /** inertial unit data */
+  boost::shared_ptr <sensor_msgs::Imu> imu_;
+
+  /** inertial unit keys group */
+  int imu_group_;
+
+  /** publish the inertial unit every imu_decimation_ loops, never if 0 */
+  int imu_decimation_;
+
+  /** sonars publishers */
+  std::vector <ros::Publisher> sonars_pub_;
+
+  /** sonars data */
+  std::vector <boost::shared_ptr <sensor_msgs::Range> > sonars_;
+
+  /** sonars keys group */
+  int sonars_group_;
+
+  /** publish the sonars every sonars_decimation_ loops, never if 0 */
+  int sonars_decimation_;
+
+  /** laser publisher */
+  ros::Publisher laser_pub_;
+
+  /** laser data */
+  boost::shared_ptr <sensor_msgs::LaserScan> laser_;
+
+  /** laser keys group, X and Y of each segment */
+  int laser_group_;
+
+  /** publish the laser every laser_decimation_ loops, never if 0 */
+  int laser_decimation_;
+};
+
+#endif // SENSORS_HPP
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SLIDING_STATS_HPP
+#define SLIDING_STATS_HPP
+
+#include <vector>
+
+#include <boost/circular_buffer.hpp>
+
+/**
+ * @brief This class keeps the statistics of the last samples of a signal
+ * Each sample costs O(1): the sums are updated incrementally and the peak
+ * is the front of a monotonic queue. Nothing is allocated after construction
+ */
+class SlidingStats
+{
+public:
+  /**
+  * @brief Constructor
+  * @param window[in] number of samples kept
+  * @param ema_alpha[in] weight of a new sample in the exponential moving average
+  */
+  SlidingStats(const int &window = 150,
+               const double &ema_alpha = 0.05);
+
+  //! @brief add a sample, dropping the oldest one if the window is full
+  void add(const float &value);
+
+  //! @brief mean over the window
+  float getMean() const;
+
+  //! @brief root mean square over the window
+  float getRms() const;
+
+  //! @brief highest absolute value over the window
+  float getPeak() const;
+
+  //! @brief exponential moving average
+  float getEma() const;
+
+private:
+  /** samples of the window */
+  boost::circular_buffer <float> samples_;
+
+  /** absolute values of the samples which can still be the peak, decreasing */
+  boost::circular_buffer <float> peaks_;
+
+  /** sums over the window */
+  double sum_;
+  double sum_squares_;
+
+  /** samples since the sums were last recomputed, to bound rounding drift */
+  int since_resum_;
+
+  /** exponential moving average and its weight */
+  double ema_;
+  double ema_alpha_;
+};
+
+#endif // SLIDING_STATS_HPP
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SUPERVISOR_HPP
+#define SUPERVISOR_HPP
+
+// ROS Headers
+#include <ros/ros.h>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include <joint_limits_interface/joint_limits.h>
+
+/**
+ * @brief This class limits the joints commands before sending them to Naoqi
+ * Position, per-period step, velocity, acceleration and jerk are clamped
+ */
+class Supervisor
+{
+public:
+  /**
+  * @brief Constructor
+  * @param controller_freq[in] frequency to write joints values
+  */
+  Supervisor(const double &controller_freq);
+
+  /**
+  * @brief load the joints limits from the URDF, then from joint_limits parameters
+  * @param joints[in] hardware interface joints names
+  * @param nh[in] node handle holding joint_limits and command_max_step
+  */
+  bool init(const std::vector <std::string> &joints,
+            const ros::NodeHandle &nh);
+
+  /**
+  * @brief set the joints limits and forget the previous commands
+  * @param joints[in] hardware interface joints names
+  * @param limits[in] limits of each joint, the missing ones are infinite
+  * @param step[in] maximum step from the current angle per period, none if not positive
+  */
+  void setLimits(const std::vector <std::string> &joints,
+                 const std::vector <joint_limits_interface::JointLimits> &limits,
+                 const double &step);
+
+  /**
+  * @brief clamp the commands in place
+  * @param commands[in,out] joints positions to apply
+  * @param vel_commands[in,out] joints velocities to apply
+  * @param angles[in] current joints angles
+  * @param active[in] joints whose commands are applied
+  * @param lead[in] time over which the position is extrapolated with the velocity when sent [s],
+  * the extrapolated position is kept within the position and step limits
+  * @return the number of clamped joints
+  */
+  int clamp(std::vector <double> *commands,
+            std::vector <double> *vel_commands,
+            const std::vector <double> &angles,
+            const std::vector <bool> &active,
+            const double &lead = 0.0);
+
+  //! @brief check if the clamped joints differ from the ones of the previous call
+  bool haveClampsChanged() const
+  {
+    return clamps_changed_;
+  }
+
+  //! @brief fill the clamp events of the last call, keeping the message allocations
+  void getClampEvents(diagnostic_msgs::DiagnosticArray *msg);
+
+private:
+  /** frequency to write joints values */
+  double controller_freq_;
+
+  /** joints names */
+  std::vector <std::string> joints_;
+
+  /** joints limits, infinite when unknown */
+  std::vector <double> pos_min_;
+  std::vector <double> pos_max_;
+  std::vector <double> vel_max_;
+  std::vector <double> acc_max_;
+  std::vector <double> jerk_max_;
+  std::vector <double> step_max_;
+
+  /** state of the last applied commands */
+  std::vector <double> prev_pos_;
+  std::vector <double> prev_vel_;
+  std::vector <double> prev_acc_;
+  std::vector <double> prev_vel_command_;
+
+  /** commands before clamping */
+  std::vector <double> requested_;
+  std::vector <double> requested_vel_;
+
+  /** joints clamped by the last call */
+  std::vector <bool> clamped_;
+
+  /** the clamped joints changed at the last call */
+  bool clamps_changed_;
+
+  /** history is initialized from the joints angles */
+  bool initialized_;
+};
+
+#endif // SUPERVISOR_HPP
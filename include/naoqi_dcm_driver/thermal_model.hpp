@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef THERMAL_MODEL_HPP
+#define THERMAL_MODEL_HPP
+
+/**
+ * @brief This class fits the thermal model of a joint online and predicts its heating
+ * dT/dt = a*I^2 - b*T + c, with I the electric current and T the temperature.
+ * The parameters are estimated by recursive least squares with forgetting,
+ * from the temperature and current averaged over fixed sample periods
+ */
+class ThermalModel
+{
+public:
+  /**
+  * @brief Constructor
+  * @param sample_period[in] period over which the measures are averaged [s]
+  * @param forgetting[in] forgetting factor of the estimation, in ]0, 1]
+  */
+  ThermalModel(const double &sample_period = 1.0,
+               const double &forgetting = 0.995);
+
+  /**
+  * @brief add a measure
+  * @param time[in] time of the measure [s]
+  * @param temperature[in] joint temperature [degree]
+  * @param current[in] joint electric current [A]
+  */
+  void update(const double &time,
+              const float &temperature,
+              const float &current);
+
+  /**
+  * @brief predict the time to reach a temperature under the current load
+  * @return 0 if already reached, infinity if never reached or if the model is not fitted yet
+  */
+  double getTimeTo(const float &temperature) const;
+
+  //! @brief get the estimated parameters of dT/dt = a*I^2 - b*T + c
+  void getParameters(double *a, double *b, double *c) const;
+
+private:
+  //! @brief recursive least squares step with the regressors phi and the measure y
+  void estimate(const double phi[3], const double &y);
+
+  /** period over which the measures are averaged */
+  double sample_period_;
+
+  /** forgetting factor */
+  double forgetting_;
+
+  /** parameters a, b, c and their covariance */
+  double theta_[3];
+  double p_[3][3];
+
+  /** number of estimation steps */
+  int estimations_;
+
+  /** measures accumulated over the current sample period */
+  double start_;
+  double sum_temperature_;
+  double sum_current2_;
+  int count_;
+
+  /** averages over the previous sample period, valid if previous_time_ >= 0 */
+  double previous_time_;
+  double previous_temperature_;
+  double previous_current2_;
+
+  /** last averages, used for the prediction */
+  double temperature_;
+  double current2_;
+};
+
+#endif // THERMAL_MODEL_HPP
@@ -23,19 +23,78 @@
 
 #include <ros/ros.h>
 
+#include <fstream>
+#include <istream>
+#include <ostream>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+
 qi::AnyValue fromStringVectorToAnyValue(const std::vector<std::string> &vector);
 
 qi::AnyValue fromDoubleVectorToAnyValue(const std::vector<double> &vector);
 
 std::vector<float> fromAnyValueToFloatVector(qi::AnyValue& value);
 
+void fromAnyValueToFloatVector(qi::AnyValue& value, std::vector<float> *result);
+
 std::vector<int> fromAnyValueToIntVector(qi::AnyValue& value);
 
 std::string print(const std::vector <std::string> &vector);
 
+//! @brief append a float with at most decimals digits after the point, without allocating once str has grown
+void appendFloat(const float &value, std::string *str, const int &decimals = 3);
+
+//! @brief overwrite str with a float, see appendFloat
+void formatFloat(const float &value, std::string *str, const int &decimals = 3);
+
 std::vector <std::string> toVector(const std::string &input);
 
 void xmlToVector(XmlRpc::XmlRpcValue &topicList,
                 std::vector <std::string> *joints);
 
+//! @brief monotonic clock [ns], cheap enough to time each call
+boost::uint64_t monotonicNs();
+
+//! @brief poll a condition until it holds or the timeout expires, return its last value
+bool waitFor(const boost::function<bool ()> &condition,
+             const double &timeout,
+             const double &period = 0.05);
+
+/*
+ * Binary files helpers, the values are in host byte order
+ * a string is its length followed by its characters
+ */
+
+//! @brief write a plain value
+template <typename T>
+void writeValue(std::ostream &out, const T &value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+//! @brief read a plain value, return false if the stream is truncated
+template <typename T>
+bool readValue(std::istream &in, T *value)
+{
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(value), sizeof(*value)));
+}
+
+void writeString(std::ostream &out, const std::string &str);
+
+//! @brief read a string, return false if truncated or longer than 4096 characters
+bool readString(std::istream &in, std::string *str);
+
+//! @brief write the number of strings, then the strings
+void writeStrings(std::ostream &out, const std::vector <std::string> &strs);
+
+//! @brief read strings written by writeStrings, at most 4096
+bool readStrings(std::istream &in, std::vector <std::string> *strs);
+
+//! @brief open the temporary file that replaceFile will move over path
+bool openTemporaryFile(const std::string &path, std::ofstream *out);
+
+//! @brief flush and close the temporary file of path and move it over path
+bool replaceFile(const std::string &path, std::ofstream *out);
+
 #endif // TOOLS_HPP
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TOPOLOGY_CACHE_HPP
+#define TOPOLOGY_CACHE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief This class stores the robot topology discovered at startup in a binary file
+ * so that the next start with the same robot type and NAOqi version skips the discovery
+ */
+class TopologyCache
+{
+public:
+  /**
+  * @brief Constructor
+  * @param path[in] cache file, caching is disabled when empty
+  */
+  TopologyCache(const std::string &path);
+
+  /**
+  * @brief load the cache file if it matches the robot
+  * @param robot[in] robot type
+  * @param version[in] NAOqi version
+  * @return true if the cached topology can be used
+  */
+  bool load(const std::string &robot,
+            const std::string &version);
+
+  //! @brief write the cache file, return false if it could not be written
+  bool save() const;
+
+  //! @brief get the body names of a robot part, return false if not cached
+  bool getBodyNames(const std::string &robot_part,
+                    std::vector <std::string> *names) const;
+
+  //! @brief set the body names of a robot part
+  void setBodyNames(const std::string &robot_part,
+                    const std::vector <std::string> &names);
+
+private:
+  /** cache file */
+  std::string path_;
+
+  /** robot type and NAOqi version the cache is valid for */
+  std::string robot_;
+  std::string version_;
+
+  /** body names per robot part */
+  std::map <std::string, std::vector <std::string> > body_names_;
+};
+
+#endif // TOPOLOGY_CACHE_HPP
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <map>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * @brief This class records spans for offline profiling
+ * The spans are written in a ring buffer allocated once when the tracing is
+ * enabled, the oldest ones being overwritten. Recording never locks nor
+ * allocates, and only costs an atomic load when the tracing is disabled.
+ * The buffer is dumped in the Chrome Trace Event format (chrome://tracing, Perfetto)
+ */
+class Tracer
+{
+public:
+  //! @brief tracer shared by all the threads of the process
+  static Tracer& instance();
+
+  //! @brief allocate the ring buffer once and start recording
+  void enable(const size_t &capacity);
+
+  //! @brief check if the spans are recorded
+  bool isEnabled() const
+  {
+    return enabled_.load(boost::memory_order_acquire);
+  }
+
+  /**
+  * @brief record a span of the calling thread
+  * @param category[in] category of the span, must outlive the tracer
+  * @param name[in] name of the span, must outlive the tracer
+  * @param start[in] begin of the span [ns]
+  * @param end[in] end of the span [ns]
+  * @param async[in] the span can overlap the others of the thread (asynchronous call)
+  */
+  void record(const char *category,
+              const char *name,
+              const boost::uint64_t &start,
+              const boost::uint64_t &end,
+              const bool &async = false);
+
+  //! @brief name the calling thread in the trace
+  void setThreadName(const std::string &name);
+
+  //! @brief write the recorded spans as Chrome Trace Event JSON
+  bool dump(const std::string &path);
+
+private:
+  Tracer();
+
+  /** a span, its sequence is 0 while it is written */
+  struct Event
+  {
+    boost::atomic <boost::uint64_t> sequence;
+    const char *category;
+    const char *name;
+    boost::uint64_t start;
+    boost::uint64_t end;
+    int tid;
+    bool async;
+  };
+
+  /** ring buffer, never reallocated once enabled */
+  boost::scoped_array <Event> events_;
+  size_t capacity_;
+
+  /** number of spans recorded so far */
+  boost::atomic <boost::uint64_t> head_;
+
+  boost::atomic <bool> enabled_;
+
+  /** protect the threads names */
+  boost::mutex mutex_;
+
+  /** names of the threads, per id */
+  std::map <int, std::string> threads_names_;
+};
+
+/**
+ * @brief This class records a span from its construction to its destruction
+ */
+class TraceSpan
+{
+public:
+  TraceSpan(const char *category, const char *name);
+
+  ~TraceSpan();
+
+private:
+  const char *category_;
+  const char *name_;
+
+  /** begin of the span, 0 if the tracing is disabled */
+  boost::uint64_t start_;
+};
+
+#endif // TRACER_HPP
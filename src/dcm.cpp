@@ -19,20 +19,19 @@
 #include <ros/ros.h>
 
 #include "naoqi_dcm_driver/dcm.hpp"
+#include "naoqi_dcm_driver/probes.hpp"
 #include "naoqi_dcm_driver/tools.hpp"
 
-DCM::DCM(const qi::SessionPtr& session,
+DCM::DCM(const qi::AnyObject& proxy,
          const double &controller_freq):
+  dcm_proxy_(proxy),
   controller_freq_(controller_freq)
 {
-  try
-  {
-    dcm_proxy_ = session->service("DCM").value();
-  }
-  catch (const std::exception& e)
-  {
-    ROS_ERROR("DCM: Failed to connect to DCM Proxy!\n\tTrace: %s", e.what());
-  }
+}
+
+void DCM::setProxy(const qi::AnyObject& proxy)
+{
+  dcm_proxy_ = proxy;
 }
 
 bool DCM::init(const std::vector <std::string> &joints)
@@ -51,6 +50,14 @@ bool DCM::init(const std::vector <std::string> &joints)
   return true;
 }
 
+bool DCM::setJoints(const std::vector <std::string> &joints)
+{
+  createPositionActuatorCommand(joints);
+
+  // Redefine the alias for Joints Actuators
+  return createPositionActuatorAlias(joints);
+}
+
 void DCM::createPositionActuatorCommand(const std::vector <std::string> &joints)
 {
   //get the number of active joints
@@ -99,7 +106,8 @@ bool DCM::createPositionActuatorAlias(const std::vector <std::string> &joints)
   // Create alias
   try
   {
-    dcm_proxy_.call<void>("createAlias", commandAlias_qi);
+    static RpcStats::Method *const create_alias_rpc = RpcStats::instance().get("createAlias");
+    dcm_proxy_.call<void>(create_alias_rpc, commandAlias_qi);
   }
   catch(const std::exception& e)
   {
@@ -135,7 +143,8 @@ bool DCM::createHardnessActuatorAlias(const std::vector <std::string> &joints)
   // Create alias
   try
   {
-    dcm_proxy_.call<void>("createAlias", commandAlias_qi);
+    static RpcStats::Method *const create_alias_rpc = RpcStats::instance().get("createAlias");
+    dcm_proxy_.call<void>(create_alias_rpc, commandAlias_qi);
   }
   catch(const std::exception& e)
   {
@@ -179,7 +188,8 @@ bool DCM::DCMAliasTimedCommand(const std::string& alias,
   // Execute Alias timed-command
   try
   {
-    dcm_proxy_.call<void>("set", command_qi);
+    static RpcStats::Method *const set_rpc = RpcStats::instance().get("set");
+    dcm_proxy_.call<void>(set_rpc, command_qi);
     return false;
   }
   catch(const std::exception& e)
@@ -194,7 +204,8 @@ int DCM::getTime(const int &offset)
   int res;
   try
   {
-    res = dcm_proxy_.call<int>("getTime", 0) + offset;
+    static RpcStats::Method *const get_time_rpc = RpcStats::instance().get("getTime");
+    res = dcm_proxy_.call<int>(get_time_rpc, 0) + offset;
   }
   catch(const std::exception& e)
   {
@@ -203,9 +214,24 @@ int DCM::getTime(const int &offset)
   return res;
 }
 
+double DCM::getCommandLead() const
+{
+  // the time of the command plus the second point of writeJoints
+  return (static_cast<int>(5000.0/controller_freq_) + static_cast<int>(1000.0/controller_freq_))/1000.0;
+}
+
 void DCM::writeJoints(const std::vector <double> &joint_commands)
 {
-  int time = getTime(static_cast<int>(5000.0/controller_freq_));
+  writeJoints(joint_commands, std::vector <double>());
+}
+
+void DCM::writeJoints(const std::vector <double> &joint_commands,
+                      const std::vector <double> &joint_velocities)
+{
+  NAOQI_DCM_PROBE_SCOPE(dcm_write_joints);
+  int offset = static_cast<int>(5000.0/controller_freq_);
+  int period = static_cast<int>(1000.0/controller_freq_);
+  int time = getTime(offset);
 
   // Create Alias timed-command
   qi::AnyValue commands_qi;
@@ -214,8 +240,25 @@ void DCM::writeJoints(const std::vector <double> &joint_commands)
     std::vector<double>::const_iterator it_comm = joint_commands.begin();
     for(int i=0; i<joint_commands.size(); ++i, ++it_comm)
     {
-      commands_values_[i][0][0] = qi::AnyValue(qi::AnyReference::from(static_cast<float>(*it_comm)), false, false);
+      double velocity = (i < joint_velocities.size()) ? joint_velocities[i] : 0.0;
+
+      // extrapolate the command to the time it is applied
+      double position = *it_comm + velocity*offset/1000.0;
+      commands_values_[i][0][0] = qi::AnyValue(qi::AnyReference::from(static_cast<float>(position)), false, false);
       commands_values_[i][0][1] = qi::AnyValue(qi::AnyReference::from(time), false, false);
+
+      // add a second point one period later to carry the velocity
+      if (velocity == 0.0)
+      {
+        commands_values_[i].resize(1);
+        continue;
+      }
+      commands_values_[i].resize(2);
+      commands_values_[i][1].resize(3);
+      position += velocity*period/1000.0;
+      commands_values_[i][1][0] = qi::AnyValue(qi::AnyReference::from(static_cast<float>(position)), false, false);
+      commands_values_[i][1][1] = qi::AnyValue(qi::AnyReference::from(time + period), false, false);
+      commands_values_[i][1][2] = qi::AnyValue(qi::AnyReference::from(0), false, false);
     }
 
     commands_[3] = qi::AnyValue(qi::AnyReference::from(commands_values_), false, false);
@@ -229,7 +272,8 @@ void DCM::writeJoints(const std::vector <double> &joint_commands)
   // Execute Alias timed-command
   try
   {
-    dcm_proxy_.call<void>("setAlias", commands_qi);
+    static RpcStats::Method *const set_alias_rpc = RpcStats::instance().get("setAlias");
+    dcm_proxy_.call<void>(set_alias_rpc, commands_qi);
   }
   catch(const std::exception& e)
   {
@@ -15,69 +15,149 @@
  *
 */
 
+#include <cmath>
+#include <limits>
+
+#include <boost/make_shared.hpp>
+
 #include <diagnostic_msgs/DiagnosticArray.h>
 
 #include "naoqi_dcm_driver/diagnostics.hpp"
+#include "naoqi_dcm_driver/probes.hpp"
 #include "naoqi_dcm_driver/tools.hpp"
 
-Diagnostics::Diagnostics(const qi::SessionPtr& session,
+Diagnostics::Diagnostics(const qi::AnyObject& memory_proxy,
                          ros::Publisher *pub,
-                         const std::vector<std::string> &joints_all_names,
-                         const std::string &robot):
+                         ros::Publisher *stats_pub,
+                         const std::vector<std::string> &joints_all_names):
     pub_(pub),
+    stats_pub_(stats_pub),
+    memory_proxy_(memory_proxy),
     joints_all_names_(joints_all_names),
     temperature_warn_level_(68.0f),
-    temperature_error_level_(73.0f)
+    temperature_error_level_(73.0f),
+    derating_temperature_(68.0f),
+    derating_current_(std::numeric_limits<float>::infinity()),
+    derating_time_to_error_(60.0f),
+    derating_temperature_hysteresis_(3.0f),
+    derating_current_hysteresis_(0.2f),
+    stats_period_(1.0),
+    heartbeat_(1.0)
 {
+  //default emission policy
+  hysteresis_[FIELD_BATTERY] = 1.0f;
+  hysteresis_[FIELD_TEMPERATURE] = 1.0f;
+  hysteresis_[FIELD_STIFFNESS] = 0.05f;
+  hysteresis_[FIELD_CURRENT] = 0.1f;
+
   //resize the joint current vector
   joints_current_.reserve(joints_all_names_.size());
   joints_current_.resize(joints_all_names_.size());
 
+  //keep the statistics of each joint
+  current_stats_.resize(joints_all_names_.size());
+  temperature_stats_.resize(joints_all_names_.size());
+
+  //fit a thermal model per joint
+  thermal_models_.resize(joints_all_names_.size());
+  times_to_error_.resize(joints_all_names_.size(), std::numeric_limits<float>::infinity());
+  forced_joints_.resize(joints_all_names_.size(), false);
+
   //set the default status
   status_.name = std::string("naoqi_dcm_driver:Status");
   status_.hardware_id = "robot";
   status_.level = diagnostic_msgs::DiagnosticStatus::OK;
   status_.message = "OK";
 
-  //connect to Memmory proxy
-  try
-  {
-    memory_proxy_ = session->service("ALMemory").value();
-  }
-  catch (const std::exception& e)
-  {
-    ROS_ERROR("DIAGNOSTICS: Failed to connect to Memory Proxy!\n\tTrace: %s", e.what());
-  }
-
-  //set the keys to check
-  keys_tocheck_.push_back("Device/SubDeviceList/Battery/Charge/Sensor/Value");
+  //set the keys to check, by tier
+  tiers_[TIER_BATTERY].keys.push_back("Device/SubDeviceList/Battery/Charge/Sensor/Value");
+  tiers_[TIER_BATTERY].period = 5.0;
 
   std::vector<std::string>::const_iterator it = joints_all_names_.begin();
   for(; it != joints_all_names_.end(); ++it) {
-    keys_tocheck_.push_back("Device/SubDeviceList/" + *it + "/Temperature/Sensor/Value");
-    keys_tocheck_.push_back("Device/SubDeviceList/" + *it + "/Hardness/Actuator/Value");
-    keys_tocheck_.push_back("Device/SubDeviceList/" + *it + "/ElectricCurrent/Sensor/Value");
+    tiers_[TIER_TEMPERATURE].keys.push_back("Device/SubDeviceList/" + *it + "/Temperature/Sensor/Value");
+    tiers_[TIER_TEMPERATURE].keys.push_back("Device/SubDeviceList/" + *it + "/Hardness/Actuator/Value");
+    tiers_[TIER_CURRENT].keys.push_back("Device/SubDeviceList/" + *it + "/ElectricCurrent/Sensor/Value");
   }
+  tiers_[TIER_TEMPERATURE].period = 1.0;
+  tiers_[TIER_CURRENT].period = 0.2;
 
-  std::vector<std::string>::const_iterator it_cntrl = joints_all_names_.begin();
-  for(; it_cntrl != joints_all_names_.end(); ++it_cntrl)
-    keys_tocheck_.push_back("Device/SubDeviceList/" + *it_cntrl + "/ElectricCurrent/Sensor/Value");
-
-  //allow the temperature reporting (for CPU)
-  try
+  for (int t=0; t<TIER_COUNT; ++t)
   {
-    if ((robot == "pepper") || (robot == "juliette") || (robot == "nao")) {
-      qi::AnyObject body_temperature_ = session->service("ALBodyTemperature").value();
-      body_temperature_.call<void>("setEnableNotifications", true);
-    }
+    tiers_[t].values.resize(tiers_[t].keys.size(), 0.0f);
+    tiers_[t].updated = false;
   }
-  catch (const std::exception& e)
+
+  //build the message skeleton, names and hardware ids never change
+  msg_ = boost::make_shared<diagnostic_msgs::DiagnosticArray>();
+  msg_->status.reserve(joints_all_names_.size() + 2);
+
+  diagnostic_updater::DiagnosticStatusWrapper status_battery;
+  status_battery.name = std::string("naoqi_dcm_driver:Battery");
+  status_battery.hardware_id = "battery";
+  status_battery.add("BatteryCharge", "");
+  msg_->status.push_back(status_battery);
+  addField(0, FIELD_BATTERY);
+
+  joints_error_messages_.reserve(joints_all_names_.size());
+  for(it = joints_all_names_.begin(); it != joints_all_names_.end(); ++it)
   {
-    ROS_WARN("DIAGNOSTICS: Failed to connect to ALBodyTemperature!\n\tTrace: %s", e.what());
+    diagnostic_updater::DiagnosticStatusWrapper status;
+    status.name = std::string("naoqi_dcm_driver:") + *it;
+    status.hardware_id = *it;
+    status.add("Temperature", "");
+    status.add("Stiffness", "");
+    status.add("ElectricCurrent", "");
+    status.add("TimeToWarning", "");
+    status.add("TimeToError", "");
+    status.add("CurrentRMS", "");
+    status.add("CurrentPeak", "");
+    msg_->status.push_back(status);
+    addField(msg_->status.size()-1, FIELD_TEMPERATURE);
+    addField(msg_->status.size()-1, FIELD_STIFFNESS);
+    addField(msg_->status.size()-1, FIELD_CURRENT);
+    joints_error_messages_.push_back("HIGH JOINT TEMPERATURE : " + *it);
   }
+
+  diagnostic_updater::DiagnosticStatusWrapper status;
+  status.name = std::string("naoqi_dcm_driver:Status");
+  status.hardware_id = "joints";
+  status.add("Highest Temperature", "");
+  status.add("Highest Stiffness", "");
+  status.add("Lowest Stiffness", "");
+  status.add("Lowest Stiffness without Hands", "");
+  status.add("Highest Electric Current", "");
+  status.add("Lowest Electric current", "");
+  status.add("Hot Joints", "");
+  status.add("Shortest Time To Error", "");
+  msg_->status.push_back(status);
+  addField(msg_->status.size()-1, FIELD_TEMPERATURE);
+  addField(msg_->status.size()-1, FIELD_STIFFNESS);
+  addField(msg_->status.size()-1, FIELD_STIFFNESS);
+  addField(msg_->status.size()-1, FIELD_STIFFNESS);
+  addField(msg_->status.size()-1, FIELD_CURRENT);
+  addField(msg_->status.size()-1, FIELD_CURRENT);
+
+  //the statistics layout never changes, the joints names are in the first label
+  stats_msg_ = boost::make_shared<std_msgs::Float32MultiArray>();
+  stats_msg_->layout.dim.resize(2);
+  stats_msg_->layout.dim[0].label = print(joints_all_names_);
+  stats_msg_->layout.dim[0].size = joints_all_names_.size();
+  stats_msg_->layout.dim[0].stride = joints_all_names_.size()*7;
+  stats_msg_->layout.dim[1].label = "current_mean current_rms current_peak current_ema "
+                                    "temperature_mean temperature_peak temperature_ema";
+  stats_msg_->layout.dim[1].size = 7;
+  stats_msg_->layout.dim[1].stride = 7;
+  stats_msg_->data.resize(joints_all_names_.size()*7, 0.0f);
+
+  //nothing is published yet, the first call sends a full snapshot
+  published_levels_.resize(msg_->status.size(), -1);
+  dirty_.resize(msg_->status.size(), false);
+  changes_msg_ = boost::make_shared<diagnostic_msgs::DiagnosticArray>();
+  changes_msg_->status.reserve(msg_->status.size());
 }
 
-void Diagnostics::setMessageFromStatus(diagnostic_updater::DiagnosticStatusWrapper &status)
+void Diagnostics::setMessageFromStatus(diagnostic_msgs::DiagnosticStatus &status)
 {
   if (status.level == diagnostic_msgs::DiagnosticStatus::OK) {
     status.message = "OK";
@@ -88,7 +168,7 @@ void Diagnostics::setMessageFromStatus(diagnostic_updater::DiagnosticStatusWrapp
    }
  }
 
-void Diagnostics::setAggregatedMessage(diagnostic_updater::DiagnosticStatusWrapper &status)
+void Diagnostics::setAggregatedMessage(const diagnostic_msgs::DiagnosticStatus &status)
 {
   if(status.level > status_.level) {
     status_.level = status.level;
@@ -96,10 +176,27 @@ void Diagnostics::setAggregatedMessage(diagnostic_updater::DiagnosticStatusWrapp
   }
 }
 
+void Diagnostics::setProxy(const qi::AnyObject& memory_proxy)
+{
+  memory_proxy_ = memory_proxy;
+}
+
 bool Diagnostics::publish()
 {
-  diagnostic_msgs::DiagnosticArray msg;
-  msg.header.stamp = ros::Time::now();
+  NAOQI_DCM_PROBE_SCOPE(diagnostics_publish);
+  const ros::Time now_ts = ros::Time::now();
+  if (!readTiers(now_ts))
+    return false;
+
+  // nothing new, the status is the one of the last read
+  if (!tiers_[TIER_BATTERY].updated && !tiers_[TIER_TEMPERATURE].updated
+      && !tiers_[TIER_CURRENT].updated)
+    return status_.level < (int) diagnostic_msgs::DiagnosticStatus::ERROR;
+
+  // a new message, as the previous one can still be used by subscribers
+  if (!msg_.unique())
+    msg_ = boost::make_shared<diagnostic_msgs::DiagnosticArray>(*msg_);
+  msg_->header.stamp = now_ts;
 
   //set the default status
   status_.level = diagnostic_msgs::DiagnosticStatus::OK;
@@ -112,29 +209,18 @@ bool Diagnostics::publish()
   float minStiffnessWoHands = 1.0f;
   float maxCurrent = 0.0f;
   float minCurrent = 10.0f;
-  std::stringstream hotJointsSS;
+  float minTimeToError = std::numeric_limits<float>::infinity();
+  const double now = msg_->header.stamp.toSec();
   diagnostic_msgs::DiagnosticStatus::_level_type max_level = diagnostic_msgs::DiagnosticStatus::OK;
 
-  std::vector<float> values;
-  try
-  {
-    qi::AnyValue keys_tocheck_qi = memory_proxy_.call<qi::AnyValue>("getListData", keys_tocheck_);
-    values = fromAnyValueToFloatVector(keys_tocheck_qi);
-  }
-  catch(const std::exception& e)
-  {
-    ROS_ERROR("DIAGNOSTICS: Could not get joint data from the robot \n\tTrace: %s", e.what());
-    return false;
-  }
+  std::vector<diagnostic_msgs::DiagnosticStatus>::iterator it_status = msg_->status.begin();
 
   //check the battery charge level
-  size_t val = 0;
-  float batteryCharge = static_cast<float>(values[val++]);
+  size_t slot = 0;
+  float batteryCharge = tiers_[TIER_BATTERY].values[0];
 
-  diagnostic_updater::DiagnosticStatusWrapper status_battery;
-  status_battery.name = std::string("naoqi_dcm_driver:Battery");
-  status_battery.hardware_id = "battery";
-  status_battery.add("BatteryCharge", batteryCharge);
+  diagnostic_msgs::DiagnosticStatus &status_battery = *it_status++;
+  setValue(slot++, batteryCharge, &status_battery.values[0].value);
 
   //TODO check if it is charging
   if (batteryCharge > 5.0f)
@@ -147,47 +233,87 @@ bool Diagnostics::publish()
     status_battery.level = diagnostic_msgs::DiagnosticStatus::ERROR;
     status_battery.message = "LOW Battery Charge";
   }
-  msg.status.push_back(status_battery);
+
+  // the hot joints text is rebuilt in place in the aggregated status
+  diagnostic_msgs::DiagnosticStatus &status = msg_->status.back();
+  std::string &hotJoints = status.values[6].value;
+  hotJoints.clear();
 
   std::vector<std::string>::iterator it_name = joints_all_names_.begin();
   std::vector<float>::iterator it_current = joints_current_.begin();
-  for(; it_name != joints_all_names_.end(); ++it_name, ++it_current)
+  std::vector<std::string>::iterator it_error = joints_error_messages_.begin();
+  std::vector<ThermalModel>::iterator it_model = thermal_models_.begin();
+  std::vector<float>::iterator it_time = times_to_error_.begin();
+  for(; it_name != joints_all_names_.end();
+      ++it_name, ++it_current, ++it_error, ++it_status, ++it_model, ++it_time)
   {
-    diagnostic_updater::DiagnosticStatusWrapper status;
-    status.name = std::string("naoqi_dcm_driver:") + *it_name;
+    diagnostic_msgs::DiagnosticStatus &status_joint = *it_status;
 
-    float temperature = static_cast<float>(values[val++]);
-    float stiffness = static_cast<float>(values[val++]);
-    *it_current = static_cast<float>(values[val++]);
+    const size_t j = it_name - joints_all_names_.begin();
+    float temperature = tiers_[TIER_TEMPERATURE].values[2*j];
+    float stiffness = tiers_[TIER_TEMPERATURE].values[2*j+1];
+    *it_current = tiers_[TIER_CURRENT].values[j];
 
     // Fill the status data
-    status.hardware_id = *it_name;
-    status.add("Temperature", temperature);
-    status.add("Stiffness", stiffness);
-    status.add("ElectricCurrent", *it_current);
+    setValue(slot++, temperature, &status_joint.values[0].value);
+    setValue(slot++, stiffness, &status_joint.values[1].value);
+    setValue(slot++, *it_current, &status_joint.values[2].value);
+
+    // update the sliding window statistics with the new samples
+    if (tiers_[TIER_CURRENT].updated)
+      current_stats_[j].add(*it_current);
+    if (tiers_[TIER_TEMPERATURE].updated)
+      temperature_stats_[j].add(temperature);
+    formatFloat(current_stats_[j].getRms(), &status_joint.values[5].value);
+    formatFloat(current_stats_[j].getPeak(), &status_joint.values[6].value);
+
+    // predict the heating under the current load
+    if (tiers_[TIER_CURRENT].updated || tiers_[TIER_TEMPERATURE].updated)
+      it_model->update(now, temperature, *it_current);
+    *it_time = static_cast<float>(it_model->getTimeTo(temperature_error_level_));
+    formatFloat(static_cast<float>(it_model->getTimeTo(temperature_warn_level_)), &status_joint.values[3].value);
+    formatFloat(*it_time, &status_joint.values[4].value);
+
+    // shed the load of the joints about to overheat, release them once cooled
+    if (!forced_joints_[j])
+    {
+      if ((temperature >= derating_temperature_) || (*it_current >= derating_current_)
+          || (*it_time <= derating_time_to_error_))
+      {
+        forced_joints_[j] = true;
+        ROS_WARN("DIAGNOSTICS: Derating the stiffness of %s (%.1f degrees, %.2f A, %.0f s to error)",
+                 it_name->c_str(), temperature, *it_current, *it_time);
+      }
+    }
+    else if ((temperature < derating_temperature_ - derating_temperature_hysteresis_)
+             && (*it_current < derating_current_ - derating_current_hysteresis_)
+             && (*it_time > 2.0f*derating_time_to_error_))
+    {
+      forced_joints_[j] = false;
+      ROS_INFO("DIAGNOSTICS: Restoring the stiffness of %s", it_name->c_str());
+    }
 
     // Define the level
     if (temperature < temperature_warn_level_)
     {
-      status.level = diagnostic_msgs::DiagnosticStatus::OK;
-      status.message = "OK";
+      status_joint.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status_joint.message = "OK";
     }
     else if (temperature < temperature_error_level_)
     {
-      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
-      status.message = "Hot";
+      status_joint.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status_joint.message = "Hot";
     }
     else
     {
-      status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
-      status.message = "HIGH JOINT TEMPERATURE : " + *it_name;
+      status_joint.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+      status_joint.message = *it_error;
     }
 
-    msg.status.push_back(status);
-    setAggregatedMessage(status);
+    setAggregatedMessage(status_joint);
 
     // Fill the joint data for later processing
-    max_level = std::max(max_level, status.level);
+    max_level = std::max(max_level, status_joint.level);
     maxTemperature = std::max(maxTemperature, temperature);
     maxStiffness = std::max(maxStiffness, stiffness);
     minStiffness = std::min(minStiffness, stiffness);
@@ -195,29 +321,30 @@ bool Diagnostics::publish()
       minStiffnessWoHands = std::min(minStiffnessWoHands, stiffness);
     maxCurrent = std::max(maxCurrent, *it_current);
     minCurrent = std::min(minCurrent, *it_current);
-    if(status.level >= (int) diagnostic_msgs::DiagnosticStatus::WARN) {
-      hotJointsSS << std::endl << *it_name << ": " << temperature << "°C";
+    minTimeToError = std::min(minTimeToError, *it_time);
+    if(status_joint.level >= (int) diagnostic_msgs::DiagnosticStatus::WARN) {
+      hotJoints += '\n';
+      hotJoints += *it_name;
+      hotJoints += ": ";
+      appendFloat(temperature, &hotJoints);
+      hotJoints += "°C";
     }
   }
 
   // Get the aggregated joints status
-  diagnostic_updater::DiagnosticStatusWrapper status;
-  status.name = std::string("naoqi_dcm_driver:Status");
-  status.hardware_id = "joints";
   status.level = max_level;
   setMessageFromStatus(status);
 
-  status.add("Highest Temperature", maxTemperature);
-  status.add("Highest Stiffness", maxStiffness);
-  status.add("Lowest Stiffness", minStiffness);
-  status.add("Lowest Stiffness without Hands", minStiffnessWoHands);
-  status.add("Highest Electric Current", maxCurrent);
-  status.add("Lowest Electric current", minCurrent);
-  status.add("Hot Joints", hotJointsSS.str());
-
-  msg.status.push_back(status);
+  setValue(slot++, maxTemperature, &status.values[0].value);
+  setValue(slot++, maxStiffness, &status.values[1].value);
+  setValue(slot++, minStiffness, &status.values[2].value);
+  setValue(slot++, minStiffnessWoHands, &status.values[3].value);
+  setValue(slot++, maxCurrent, &status.values[4].value);
+  setValue(slot++, minCurrent, &status.values[5].value);
+  formatFloat(minTimeToError, &status.values[7].value);
 
-  pub_->publish(msg);
+  emit(msg_->header.stamp);
+  publishStats(msg_->header.stamp);
 
   if(status_.level >= (int) diagnostic_msgs::DiagnosticStatus::ERROR)
   {
@@ -228,6 +355,220 @@ bool Diagnostics::publish()
     return true;
 }
 
+void Diagnostics::loadParams(const ros::NodeHandle &nh)
+{
+  nh.getParam("diagnostics_heartbeat", heartbeat_);
+  nh.getParam("diagnostics_hysteresis/battery", hysteresis_[FIELD_BATTERY]);
+  nh.getParam("diagnostics_hysteresis/temperature", hysteresis_[FIELD_TEMPERATURE]);
+  nh.getParam("diagnostics_hysteresis/stiffness", hysteresis_[FIELD_STIFFNESS]);
+  nh.getParam("diagnostics_hysteresis/current", hysteresis_[FIELD_CURRENT]);
+
+  const char *tiers_names[TIER_COUNT] = {"battery", "temperature", "current"};
+  for (int t=0; t<TIER_COUNT; ++t)
+  {
+    double rate(0.0);
+    if (nh.getParam(std::string("diagnostics_rates/") + tiers_names[t], rate))
+      tiers_[t].period = (rate > 0.0) ? 1.0/rate : 0.0;
+  }
+
+  nh.getParam("derating/temperature", derating_temperature_);
+  nh.getParam("derating/temperature_hysteresis", derating_temperature_hysteresis_);
+  nh.getParam("derating/current", derating_current_);
+  nh.getParam("derating/current_hysteresis", derating_current_hysteresis_);
+  nh.getParam("derating/time_to_error", derating_time_to_error_);
+
+  int window(150);
+  double ema_alpha(0.05);
+  nh.getParam("joint_stats/window", window);
+  nh.getParam("joint_stats/ema_alpha", ema_alpha);
+  nh.getParam("joint_stats/period", stats_period_);
+  if ((window <= 0) || (ema_alpha <= 0.0) || (ema_alpha > 1.0))
+    ROS_WARN("DIAGNOSTICS: Ignoring the invalid joint statistics parameters");
+  else
+  {
+    current_stats_.assign(joints_all_names_.size(), SlidingStats(window, ema_alpha));
+    temperature_stats_.assign(joints_all_names_.size(), SlidingStats(window, ema_alpha));
+  }
+
+  double sample_period(1.0), forgetting(0.995);
+  nh.getParam("thermal_model/sample_period", sample_period);
+  nh.getParam("thermal_model/forgetting", forgetting);
+  if ((sample_period <= 0.0) || (forgetting <= 0.0) || (forgetting > 1.0))
+    ROS_WARN("DIAGNOSTICS: Ignoring the invalid thermal model parameters");
+  else
+    thermal_models_.assign(joints_all_names_.size(), ThermalModel(sample_period, forgetting));
+}
+
+bool Diagnostics::readTiers(const ros::Time &ts)
+{
+  qi::Future<qi::AnyValue> futures[TIER_COUNT];
+  for (int t=0; t<TIER_COUNT; ++t)
+  {
+    KeysTier &tier = tiers_[t];
+    tier.updated = tier.last.isZero() || ((ts - tier.last).toSec() >= tier.period);
+    if (!tier.updated || tier.keys.empty())
+      continue;
+    try
+    {
+      static RpcStats::Method *const get_list_data_rpc = RpcStats::instance().get("getListData");
+      futures[t] = memory_proxy_.async<qi::AnyValue>(get_list_data_rpc, tier.keys);
+    }
+    catch(const std::exception& e)
+    {
+      ROS_ERROR("DIAGNOSTICS: Could not get joint data from the robot \n\tTrace: %s", e.what());
+      return false;
+    }
+  }
+
+  // the tiers share the deadline, a late read is canceled and counted as a timeout
+  const boost::uint64_t deadline = monotonicNs() + RpcStats::instance().getTimeout();
+  bool res = true;
+  for (int t=0; t<TIER_COUNT; ++t)
+  {
+    if (!futures[t].isValid())
+      continue;
+
+    KeysTier &tier = tiers_[t];
+    const qi::FutureState state = RpcProxy::wait(futures[t], deadline);
+    if (state != qi::FutureState_FinishedWithValue)
+    {
+      ROS_ERROR("DIAGNOSTICS: Could not get joint data from the robot \n\tTrace: %s",
+                (state == qi::FutureState_Running) ? "timeout"
+                : futures[t].hasError(0) ? futures[t].error().c_str() : "canceled");
+      tier.updated = false;
+      res = false;
+      continue;
+    }
+
+    qi::AnyValue values = futures[t].value();
+    fromAnyValueToFloatVector(values, &tier.values);
+    if (tier.values.size() != tier.keys.size())
+    {
+      ROS_ERROR("DIAGNOSTICS: Could not get joint data from the robot");
+      tier.values.resize(tier.keys.size(), 0.0f);
+      tier.updated = false;
+      res = false;
+      continue;
+    }
+  }
+  if (!res)
+    return false;
+
+  // the samples are only used when all the tiers are read
+  for (int t=0; t<TIER_COUNT; ++t)
+    if (futures[t].isValid())
+      tiers_[t].last = ts;
+  return true;
+}
+
+void Diagnostics::publishStats(const ros::Time &ts)
+{
+  if ((stats_period_ <= 0.0)
+      || (!last_stats_.isZero() && ((ts - last_stats_).toSec() < stats_period_)))
+    return;
+  last_stats_ = ts;
+
+  // a new message, as the previous one can still be used by subscribers
+  if (!stats_msg_.unique())
+    stats_msg_ = boost::make_shared<std_msgs::Float32MultiArray>(*stats_msg_);
+
+  std::vector<float>::iterator it = stats_msg_->data.begin();
+  for (size_t j=0; j<joints_all_names_.size(); ++j)
+  {
+    *it++ = current_stats_[j].getMean();
+    *it++ = current_stats_[j].getRms();
+    *it++ = current_stats_[j].getPeak();
+    *it++ = current_stats_[j].getEma();
+    *it++ = temperature_stats_[j].getMean();
+    *it++ = temperature_stats_[j].getPeak();
+    *it++ = temperature_stats_[j].getEma();
+  }
+  stats_pub_->publish(stats_msg_);
+}
+
+const std::vector <float>& Diagnostics::getTimesToError() const
+{
+  return times_to_error_;
+}
+
+const std::vector <bool>& Diagnostics::getForcedJoints() const
+{
+  return forced_joints_;
+}
+
+const std::vector <std::string>& Diagnostics::getJointsNames() const
+{
+  return joints_all_names_;
+}
+
+void Diagnostics::addField(const size_t &status, const Field &field)
+{
+  fields_status_.push_back(status);
+  fields_kind_.push_back(field);
+  fields_value_.push_back(0.0f);
+  fields_published_.push_back(0.0f);
+}
+
+void Diagnostics::setValue(const size_t &slot, const float &value, std::string *str)
+{
+  fields_value_[slot] = value;
+  formatFloat(value, str);
+}
+
+void Diagnostics::emit(const ros::Time &ts)
+{
+  const bool snapshot = (heartbeat_ <= 0.0) || last_snapshot_.isZero()
+      || ((ts - last_snapshot_).toSec() >= heartbeat_);
+
+  // level transitions, the aggregated status follows any of them
+  bool level_changed = false;
+  for (size_t i=0; i<msg_->status.size(); ++i)
+  {
+    dirty_[i] = snapshot || (msg_->status[i].level != published_levels_[i]);
+    level_changed = level_changed || dirty_[i];
+  }
+  if (level_changed)
+    dirty_.back() = true;
+
+  // numeric changes beyond the hysteresis of their field
+  for (size_t k=0; k<fields_value_.size(); ++k)
+    if (std::fabs(fields_value_[k] - fields_published_[k]) > hysteresis_[fields_kind_[k]])
+      dirty_[fields_status_[k]] = true;
+
+  // record what is published
+  for (size_t k=0; k<fields_value_.size(); ++k)
+    if (dirty_[fields_status_[k]])
+      fields_published_[k] = fields_value_[k];
+  size_t count = 0;
+  for (size_t i=0; i<msg_->status.size(); ++i)
+    if (dirty_[i])
+    {
+      published_levels_[i] = msg_->status[i].level;
+      ++count;
+    }
+
+  if (snapshot)
+  {
+    last_snapshot_ = ts;
+    pub_->publish(msg_);
+    return;
+  }
+  if (count == 0)
+    return;
+
+  // a new message, as the previous one can still be used by subscribers
+  if (!changes_msg_.unique())
+    changes_msg_ = boost::make_shared<diagnostic_msgs::DiagnosticArray>(*changes_msg_);
+  changes_msg_->header.stamp = ts;
+  changes_msg_->status.resize(count);
+
+  std::vector<diagnostic_msgs::DiagnosticStatus>::iterator it = changes_msg_->status.begin();
+  for (size_t i=0; i<msg_->status.size(); ++i)
+    if (dirty_[i])
+      *it++ = msg_->status[i];
+  pub_->publish(changes_msg_);
+}
+
 std::string Diagnostics::getStatusMsg()
 {
   return status_.message;
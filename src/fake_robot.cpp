@@ -0,0 +1,426 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <boost/random/uniform_real_distribution.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "naoqi_dcm_driver/fake_robot.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+
+namespace
+{
+/** time constant of a joint at full stiffness [s] */
+const float JOINT_TAU = 0.05f;
+
+/** maximum speed of a joint [rad/s] */
+const float JOINT_MAX_VELOCITY = 3.0f;
+
+/** current drawn per radian of tracking error and at rest, at full stiffness [A] */
+const float CURRENT_GAIN = 4.0f;
+const float CURRENT_IDLE = 0.1f;
+const float CURRENT_MAX = 2.5f;
+
+/** heating a [degC/s/A^2], cooling b [1/s] and ambient temperature [degC] */
+const float HEATING = 0.15f;
+const float COOLING = 1.0f/300.0f;
+const float AMBIENT = 35.0f;
+
+/** time constant of the base [s] */
+const float BASE_TAU = 1.0f;
+
+/** battery discharge [1/s] */
+const float DISCHARGE = 0.01f/300.0f;
+
+const std::string PREFIX = "Device/SubDeviceList/";
+
+std::vector <std::string> makeList(const char **names, const size_t &size)
+{
+  return std::vector <std::string>(names, names + size);
+}
+
+void append(std::vector <std::string> *names, const std::vector <std::string> &others)
+{
+  names->insert(names->end(), others.begin(), others.end());
+}
+}
+
+FakeRobot::Faults::Faults():
+  latency(0.0),
+  jitter(0.0),
+  error_rate(0.0),
+  stall_rate(0.0),
+  stall_duration(0.0)
+{
+}
+
+FakeRobot::FakeRobot(const std::string &body_type,
+                     const std::string &version):
+  body_type_(body_type),
+  version_(version),
+  battery_(1.0f),
+  awake_(false),
+  last_update_(monotonicNs())
+{
+  static const char *head[] = {"HeadYaw", "HeadPitch"};
+  static const char *larm[] = {"LShoulderPitch", "LShoulderRoll", "LElbowYaw", "LElbowRoll", "LWristYaw", "LHand"};
+  static const char *rarm[] = {"RShoulderPitch", "RShoulderRoll", "RElbowYaw", "RElbowRoll", "RWristYaw", "RHand"};
+  static const char *leg[] = {"HipRoll", "HipPitch", "KneePitch"};
+  static const char *wheels[] = {"WheelFL", "WheelFR", "WheelB"};
+  static const char *lleg[] = {"LHipYawPitch", "LHipRoll", "LHipPitch", "LKneePitch", "LAnklePitch", "LAnkleRoll"};
+  static const char *rleg[] = {"RHipYawPitch", "RHipRoll", "RHipPitch", "RKneePitch", "RAnklePitch", "RAnkleRoll"};
+
+  chains_["Head"] = makeList(head, 2);
+  chains_["LArm"] = makeList(larm, 6);
+  chains_["RArm"] = makeList(rarm, 6);
+
+  std::vector <std::string> &actuators = chains_["JointActuators"];
+  append(&actuators, chains_["Head"]);
+  if (body_type_ == "nao")
+  {
+    chains_["LLeg"] = makeList(lleg, 6);
+    chains_["RLeg"] = makeList(rleg, 6);
+    append(&actuators, chains_["LArm"]);
+    append(&actuators, chains_["LLeg"]);
+    append(&actuators, chains_["RLeg"]);
+    append(&actuators, chains_["RArm"]);
+    chains_["Body"] = actuators;
+  }
+  else
+  {
+    chains_["Leg"] = makeList(leg, 3);
+    append(&actuators, chains_["Leg"]);
+    append(&actuators, chains_["LArm"]);
+    append(&actuators, chains_["RArm"]);
+    chains_["Body"] = actuators;
+    append(&chains_["Body"], makeList(wheels, 3));
+  }
+  chains_["Joints"] = chains_["Body"];
+
+  const std::vector <std::string> &body = chains_["Body"];
+  for (size_t i=0; i<body.size(); ++i)
+  {
+    Joint &joint = joints_[body[i]];
+    joint.position = 0.0f;
+    joint.target = 0.0f;
+    joint.velocity = 0.0f;
+    joint.max_velocity = JOINT_MAX_VELOCITY;
+    joint.stiffness = 0.0f;
+    joint.current = 0.0f;
+    joint.temperature = AMBIENT;
+  }
+
+  std::fill(base_, base_ + 3, 0.0f);
+  std::fill(base_target_, base_target_ + 3, 0.0f);
+  std::fill(base_velocity_, base_velocity_ + 3, 0.0f);
+}
+
+void FakeRobot::setFaults(const Faults &faults)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  faults_ = faults;
+}
+
+void FakeRobot::rpc(const std::string &method)
+{
+  double delay(0.0);
+  bool fail(false);
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    boost::random::uniform_real_distribution<double> uniform(0.0, 1.0);
+    delay = faults_.latency + faults_.jitter*uniform(random_);
+    if (faults_.stalling.count(method)
+        || ((faults_.stall_rate > 0.0) && (uniform(random_) < faults_.stall_rate)))
+      delay += faults_.stall_duration;
+    fail = faults_.failing.count(method)
+        || ((faults_.error_rate > 0.0) && (uniform(random_) < faults_.error_rate));
+  }
+
+  // the plant keeps going meanwhile, as the calls do not lock it while waiting
+  if (delay > 0.0)
+    boost::this_thread::sleep(boost::posix_time::microseconds(static_cast<long>(delay*1e6)));
+  if (fail)
+    throw std::runtime_error("Injected failure of " + method);
+}
+
+const std::string& FakeRobot::getBodyType() const
+{
+  return body_type_;
+}
+
+const std::string& FakeRobot::getVersion() const
+{
+  return version_;
+}
+
+std::vector <std::string> FakeRobot::getBodyNames(const std::string &name) const
+{
+  std::map <std::string, std::vector <std::string> >::const_iterator it = chains_.find(name);
+  if (it != chains_.end())
+    return it->second;
+  if (joints_.count(name))
+    return std::vector <std::string>(1, name);
+  return std::vector <std::string>();
+}
+
+void FakeRobot::update()
+{
+  const boost::uint64_t now = monotonicNs();
+  const float dt = (now - last_update_)*1e-9f;
+  last_update_ = now;
+  if (dt <= 0.0f)
+    return;
+
+  std::map <std::string, Joint>::iterator it = joints_.begin();
+  for (; it != joints_.end(); ++it)
+  {
+    Joint &joint = it->second;
+    float error = joint.target - joint.position;
+
+    // a joint without stiffness holds its position
+    if (joint.stiffness > 0.0f)
+    {
+      float step = error*(1.0f - std::exp(-dt*joint.stiffness/JOINT_TAU));
+      const float max_step = joint.max_velocity*dt;
+      step = std::max(-max_step, std::min(step, max_step));
+      joint.position += step;
+      joint.velocity = step/dt;
+      error -= step;
+    }
+    else
+      joint.velocity = 0.0f;
+
+    joint.current = std::min(joint.stiffness*(CURRENT_GAIN*std::fabs(error) + CURRENT_IDLE), CURRENT_MAX);
+
+    // exact for a constant current over dt
+    const float equilibrium = AMBIENT + HEATING*joint.current*joint.current/COOLING;
+    joint.temperature = equilibrium + (joint.temperature - equilibrium)*std::exp(-COOLING*dt);
+  }
+
+  const float base_decay = 1.0f - std::exp(-dt/BASE_TAU);
+  for (int i=0; i<3; ++i)
+  {
+    const float step = (base_target_[i] - base_[i])*base_decay;
+    base_[i] += step;
+    base_velocity_[i] = step/dt;
+  }
+
+  battery_ = std::max(battery_ - DISCHARGE*dt, 0.05f);
+}
+
+FakeRobot::Joint* FakeRobot::findJoint(const std::string &key, std::string *field)
+{
+  if (key.compare(0, PREFIX.size(), PREFIX) != 0)
+    return NULL;
+
+  const size_t end = key.find('/', PREFIX.size());
+  if (end == std::string::npos)
+    return NULL;
+
+  std::map <std::string, Joint>::iterator it = joints_.find(key.substr(PREFIX.size(), end - PREFIX.size()));
+  if (it == joints_.end())
+    return NULL;
+
+  *field = key.substr(end + 1);
+  return &it->second;
+}
+
+float FakeRobot::getData(const std::string &key)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+  return readKey(key);
+}
+
+float FakeRobot::readKey(const std::string &key)
+{
+  std::map <std::string, float>::const_iterator it = data_.find(key);
+  if (it != data_.end())
+    return it->second;
+
+  std::string field;
+  const Joint *joint = findJoint(key, &field);
+  if (joint)
+  {
+    if (field == "Position/Sensor/Value")
+      return joint->position;
+    if (field == "Position/Actuator/Value")
+      return joint->target;
+    if (field == "Speed/Sensor/Value")
+      return joint->velocity;
+    if (field == "Hardness/Actuator/Value")
+      return joint->stiffness;
+    if (field == "ElectricCurrent/Sensor/Value")
+      return joint->current;
+    if (field == "Temperature/Sensor/Value")
+      return joint->temperature;
+    return 0.0f;
+  }
+
+  if (key == PREFIX + "Battery/Charge/Sensor/Value")
+    return battery_;
+  if (key == PREFIX + "InertialSensor/AccelerometerZ/Sensor/Value")
+    return -9.81f;
+  return 0.0f;
+}
+
+std::vector <float> FakeRobot::getListData(const std::vector <std::string> &keys)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+
+  std::vector <float> res(keys.size());
+  for (size_t i=0; i<keys.size(); ++i)
+    res[i] = readKey(keys[i]);
+  return res;
+}
+
+void FakeRobot::setData(const std::string &key, const float &value)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (value != value)
+    data_.erase(key);
+  else
+    data_[key] = value;
+}
+
+void FakeRobot::setActuator(const std::string &key, const float &value)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+
+  std::string field;
+  Joint *joint = findJoint(key, &field);
+  if (!joint)
+    return;
+
+  if (field == "Position/Actuator/Value")
+  {
+    joint->target = value;
+    joint->max_velocity = JOINT_MAX_VELOCITY;
+  }
+  else if (field == "Hardness/Actuator/Value")
+    joint->stiffness = std::max(0.0f, std::min(value, 1.0f));
+}
+
+void FakeRobot::setAngles(const std::vector <std::string> &names,
+                          const std::vector <float> &angles,
+                          const float &speed)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+
+  for (size_t i=0; (i<names.size()) && (i<angles.size()); ++i)
+  {
+    std::map <std::string, Joint>::iterator it = joints_.find(names[i]);
+    if (it == joints_.end())
+      throw std::runtime_error("Unknown joint " + names[i]);
+    it->second.target = angles[i];
+    it->second.max_velocity = JOINT_MAX_VELOCITY*std::max(0.0f, std::min(speed, 1.0f));
+  }
+}
+
+std::vector <float> FakeRobot::getAngles(const std::vector <std::string> &names,
+                                         const bool &use_sensors)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+
+  std::vector <float> res;
+  for (size_t i=0; i<names.size(); ++i)
+  {
+    const std::vector <std::string> joints = getBodyNames(names[i]);
+    for (size_t j=0; j<joints.size(); ++j)
+    {
+      const Joint &joint = joints_[joints[j]];
+      res.push_back(use_sensors ? joint.position : joint.target);
+    }
+  }
+  return res;
+}
+
+void FakeRobot::setStiffnesses(const std::vector <std::string> &names,
+                               const std::vector <float> &stiffnesses)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+
+  for (size_t i=0; i<names.size(); ++i)
+  {
+    const float stiffness = stiffnesses.empty() ? 0.0f : stiffnesses[std::min(i, stiffnesses.size() - 1)];
+    const std::vector <std::string> joints = getBodyNames(names[i]);
+    for (size_t j=0; j<joints.size(); ++j)
+      joints_[joints[j]].stiffness = std::max(0.0f, std::min(stiffness, 1.0f));
+  }
+}
+
+void FakeRobot::setAwake(const bool &awake)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+
+  std::map <std::string, Joint>::iterator it = joints_.begin();
+  for (; it != joints_.end(); ++it)
+  {
+    it->second.target = it->second.position;
+    it->second.stiffness = awake ? 1.0f : 0.0f;
+  }
+  awake_ = awake;
+}
+
+bool FakeRobot::isAwake()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return awake_;
+}
+
+void FakeRobot::moveTo(const float &x, const float &y, const float &theta)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+
+  const float c = std::cos(base_target_[2]);
+  const float s = std::sin(base_target_[2]);
+  base_target_[0] += c*x - s*y;
+  base_target_[1] += s*x + c*y;
+  base_target_[2] += theta;
+}
+
+std::vector <float> FakeRobot::getRobotPosition()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+  return std::vector <float>(base_, base_ + 3);
+}
+
+std::vector <float> FakeRobot::getRobotVelocity()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  update();
+
+  // the velocity is given in the robot frame
+  const float c = std::cos(base_[2]);
+  const float s = std::sin(base_[2]);
+  std::vector <float> res(3);
+  res[0] = c*base_velocity_[0] + s*base_velocity_[1];
+  res[1] = -s*base_velocity_[0] + c*base_velocity_[1];
+  res[2] = base_velocity_[2];
+  return res;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <vector>
+
+// NAOqi Headers
+#include <qi/application.hpp>
+
+#include "naoqi_dcm_driver/fake_services.hpp"
+#include "naoqi_dcm_driver/robot.hpp"
+
+/*
+ * Serve the stand-in Naoqi services on a local session, so that the driver
+ * runs without a robot. With ~fake/driver, the driver runs in this process
+ * and takes its usual private parameters; otherwise start it with
+ * RobotIP:=127.0.0.1 and the port of ~fake/listen_url
+ */
+
+int main(int argc, char** argv)
+{
+  // Need this to for SOAP serialization of floats to work
+  setlocale(LC_NUMERIC, "C");
+
+  qi::Application app(argc, argv);
+
+  ros::init(argc, argv, "naoqi_dcm_driver_fake_robot");
+  ros::NodeHandle pnh("~");
+
+  // Load Params from Parameter Server
+  std::string listen_url = "tcp://127.0.0.1:9559";
+  std::string body_type = "pepper";
+  std::string version = "2.5.0.fake";
+  bool run_driver = false;
+  pnh.getParam("fake/listen_url", listen_url);
+  pnh.getParam("fake/body_type", body_type);
+  pnh.getParam("fake/version", version);
+  pnh.getParam("fake/driver", run_driver);
+
+  FakeRobot::Faults faults;
+  std::vector <std::string> failing, stalling;
+  pnh.getParam("fake/rpc/latency", faults.latency);
+  pnh.getParam("fake/rpc/jitter", faults.jitter);
+  pnh.getParam("fake/rpc/error_rate", faults.error_rate);
+  pnh.getParam("fake/rpc/stall_rate", faults.stall_rate);
+  pnh.getParam("fake/rpc/stall_duration", faults.stall_duration);
+  pnh.getParam("fake/rpc/failing", failing);
+  pnh.getParam("fake/rpc/stalling", stalling);
+  faults.failing.insert(failing.begin(), failing.end());
+  faults.stalling.insert(stalling.begin(), stalling.end());
+
+  boost::shared_ptr<FakeRobot> plant = boost::make_shared<FakeRobot>(body_type, version);
+  plant->setFaults(faults);
+
+  //serve the stand-in services
+  qi::SessionPtr server = qi::makeSession();
+  try
+  {
+    server->listenStandalone(listen_url).value();
+  }
+  catch(const std::exception &e)
+  {
+    ROS_ERROR("Cannot listen on %s, %s", listen_url.c_str(), e.what());
+    return -1;
+  }
+  if (!registerFakeServices(server, plant))
+  {
+    server->close();
+    return -1;
+  }
+  ROS_INFO_STREAM("Stand-in " << body_type << " services listening on " << listen_url);
+
+  if (!run_driver)
+  {
+    ros::spin();
+    server->close();
+    return 0;
+  }
+
+  //connect the driver through its own session, as to a robot
+  qi::SessionPtr session = qi::makeSession();
+  try
+  {
+    session->connect(listen_url).value();
+  }
+  catch(const std::exception &e)
+  {
+    ROS_ERROR("Cannot connect to session, %s", e.what());
+    server->close();
+    return -1;
+  }
+
+  boost::shared_ptr<Robot> robot = boost::make_shared<Robot>(session);
+
+  robot->registerService();
+
+  if (!robot->connect())
+  {
+    session->close();
+    server->close();
+    return 0;
+  }
+
+  // Run the spinner in a separate thread to prevent lockups
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  // Run the main Loop
+  robot->run();
+
+  //release stiffness and stop correctly
+  robot->stopService();
+
+  session->close();
+  spinner.stop();
+  server->close();
+
+  return 0;
+}
@@ -0,0 +1,400 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <stdexcept>
+
+#include <boost/make_shared.hpp>
+
+// ROS Headers
+#include <ros/ros.h>
+
+#include "naoqi_dcm_driver/fake_services.hpp"
+
+QI_REGISTER_OBJECT(FakeMemory,
+                   getData,
+                   getListData,
+                   insertData,
+                   version,
+                   subscribeToMicroEvent,
+                   unsubscribeToMicroEvent);
+
+QI_REGISTER_OBJECT(FakeMotion,
+                   getBodyNames,
+                   robotIsWakeUp,
+                   wakeUp,
+                   rest,
+                   setAngles,
+                   getAngles,
+                   stiffnessInterpolation,
+                   setStiffnesses,
+                   moveTo,
+                   getRobotPosition,
+                   getRobotVelocity,
+                   setMoveArmsEnabled,
+                   setExternalCollisionProtectionEnabled,
+                   setSmartStiffnessEnabled,
+                   setPushRecoveryEnabled);
+
+QI_REGISTER_OBJECT(FakeDCM,
+                   createAlias,
+                   setAlias,
+                   set,
+                   getTime);
+
+QI_REGISTER_OBJECT(FakeBodyTemperature,
+                   setEnableNotifications);
+
+QI_REGISTER_OBJECT(FakeTouch,
+                   exit);
+
+QI_REGISTER_OBJECT(FakeAutonomousLife,
+                   getState,
+                   setState);
+
+namespace
+{
+/** the value itself, unwrapped from its dynamic containers */
+qi::AnyReference unwrap(qi::AnyReference ref)
+{
+  while (ref.kind() == qi::TypeKind_Dynamic)
+    ref = ref.content();
+  return ref;
+}
+
+/** elements of a list */
+qi::AnyReferenceVector asList(const qi::AnyReference &ref)
+{
+  qi::AnyReference list = unwrap(ref);
+  if (list.kind() != qi::TypeKind_List)
+    throw std::runtime_error("Expected a list");
+  return list.asListValuePtr();
+}
+
+/** a name or a list of names */
+std::vector <std::string> toStrings(const qi::AnyValue &value)
+{
+  qi::AnyReference ref = unwrap(value.asReference());
+  if (ref.kind() == qi::TypeKind_String)
+    return std::vector <std::string>(1, ref.toString());
+
+  qi::AnyReferenceVector refs = asList(ref);
+  std::vector <std::string> res(refs.size());
+  for (size_t i=0; i<refs.size(); ++i)
+    res[i] = unwrap(refs[i]).toString();
+  return res;
+}
+
+/** a number or a list of numbers */
+std::vector <float> toFloats(const qi::AnyValue &value)
+{
+  qi::AnyReference ref = unwrap(value.asReference());
+  if (ref.kind() != qi::TypeKind_List)
+    return std::vector <float>(1, ref.toFloat());
+
+  qi::AnyReferenceVector refs = asList(ref);
+  std::vector <float> res(refs.size());
+  for (size_t i=0; i<refs.size(); ++i)
+    res[i] = unwrap(refs[i]).toFloat();
+  return res;
+}
+}
+
+FakeMemory::FakeMemory(const boost::shared_ptr <FakeRobot> &robot):
+  robot_(robot)
+{
+}
+
+qi::AnyValue FakeMemory::getData(const std::string &key)
+{
+  robot_->rpc("ALMemory.getData");
+  if (key == "RobotConfig/Body/Type")
+    return qi::AnyValue::from(robot_->getBodyType());
+  return qi::AnyValue::from(robot_->getData(key));
+}
+
+std::vector <qi::AnyValue> FakeMemory::getListData(const std::vector <std::string> &keys)
+{
+  robot_->rpc("ALMemory.getListData");
+
+  // like ALMemory, a list of dynamic values
+  const std::vector <float> values = robot_->getListData(keys);
+  std::vector <qi::AnyValue> res(values.size());
+  for (size_t i=0; i<values.size(); ++i)
+    res[i] = qi::AnyValue::from(values[i]);
+  return res;
+}
+
+void FakeMemory::insertData(const std::string &key, const float &value)
+{
+  robot_->rpc("ALMemory.insertData");
+  robot_->setData(key, value);
+}
+
+std::string FakeMemory::version()
+{
+  robot_->rpc("ALMemory.version");
+  return robot_->getVersion();
+}
+
+int FakeMemory::subscribeToMicroEvent(const std::string &name, const std::string &module,
+                                      const std::string &message, const std::string &method)
+{
+  robot_->rpc("ALMemory.subscribeToMicroEvent");
+  return 0;
+}
+
+void FakeMemory::unsubscribeToMicroEvent(const std::string &name, const std::string &module)
+{
+  robot_->rpc("ALMemory.unsubscribeToMicroEvent");
+}
+
+FakeMotion::FakeMotion(const boost::shared_ptr <FakeRobot> &robot):
+  robot_(robot)
+{
+}
+
+std::vector <std::string> FakeMotion::getBodyNames(const std::string &name)
+{
+  robot_->rpc("ALMotion.getBodyNames");
+  return robot_->getBodyNames(name);
+}
+
+bool FakeMotion::robotIsWakeUp()
+{
+  robot_->rpc("ALMotion.robotIsWakeUp");
+  return robot_->isAwake();
+}
+
+void FakeMotion::wakeUp()
+{
+  robot_->rpc("ALMotion.wakeUp");
+  robot_->setAwake(true);
+}
+
+void FakeMotion::rest()
+{
+  robot_->rpc("ALMotion.rest");
+  robot_->setAwake(false);
+}
+
+void FakeMotion::setAngles(const qi::AnyValue &names, const qi::AnyValue &angles, const float &speed)
+{
+  robot_->rpc("ALMotion.setAngles");
+  robot_->setAngles(toStrings(names), toFloats(angles), speed);
+}
+
+std::vector <float> FakeMotion::getAngles(const qi::AnyValue &names, const bool &use_sensors)
+{
+  robot_->rpc("ALMotion.getAngles");
+  return robot_->getAngles(toStrings(names), use_sensors);
+}
+
+void FakeMotion::stiffnessInterpolation(const qi::AnyValue &names, const qi::AnyValue &stiffnesses,
+                                        const qi::AnyValue &times)
+{
+  // the interpolation is not simulated, the stiffness is set at once
+  robot_->rpc("ALMotion.stiffnessInterpolation");
+  robot_->setStiffnesses(toStrings(names), toFloats(stiffnesses));
+}
+
+void FakeMotion::setStiffnesses(const qi::AnyValue &names, const qi::AnyValue &stiffnesses)
+{
+  robot_->rpc("ALMotion.setStiffnesses");
+  robot_->setStiffnesses(toStrings(names), toFloats(stiffnesses));
+}
+
+void FakeMotion::moveTo(const float &x, const float &y, const float &theta)
+{
+  robot_->rpc("ALMotion.moveTo");
+  robot_->moveTo(x, y, theta);
+}
+
+std::vector <float> FakeMotion::getRobotPosition(const bool &use_sensors)
+{
+  robot_->rpc("ALMotion.getRobotPosition");
+  return robot_->getRobotPosition();
+}
+
+std::vector <float> FakeMotion::getRobotVelocity()
+{
+  robot_->rpc("ALMotion.getRobotVelocity");
+  return robot_->getRobotVelocity();
+}
+
+void FakeMotion::setMoveArmsEnabled(const bool &left, const bool &right)
+{
+  robot_->rpc("ALMotion.setMoveArmsEnabled");
+}
+
+void FakeMotion::setExternalCollisionProtectionEnabled(const std::string &name, const bool &enabled)
+{
+  robot_->rpc("ALMotion.setExternalCollisionProtectionEnabled");
+}
+
+void FakeMotion::setSmartStiffnessEnabled(const bool &enabled)
+{
+  robot_->rpc("ALMotion.setSmartStiffnessEnabled");
+}
+
+void FakeMotion::setPushRecoveryEnabled(const bool &enabled)
+{
+  robot_->rpc("ALMotion.setPushRecoveryEnabled");
+}
+
+FakeDCM::FakeDCM(const boost::shared_ptr <FakeRobot> &robot):
+  robot_(robot),
+  start_(qi::os::ustime())
+{
+}
+
+void FakeDCM::createAlias(const qi::AnyValue &alias)
+{
+  robot_->rpc("DCM.createAlias");
+
+  // [name, [keys]]
+  qi::AnyReferenceVector fields = asList(alias.asReference());
+  if (fields.size() < 2)
+    throw std::runtime_error("DCM: invalid alias");
+
+  std::vector <std::string> keys;
+  qi::AnyReferenceVector keys_refs = asList(fields[1]);
+  for (size_t i=0; i<keys_refs.size(); ++i)
+    keys.push_back(unwrap(keys_refs[i]).toString());
+
+  boost::mutex::scoped_lock lock(mutex_);
+  aliases_[unwrap(fields[0]).toString()] = keys;
+}
+
+void FakeDCM::setAlias(const qi::AnyValue &commands)
+{
+  robot_->rpc("DCM.setAlias");
+
+  // [name, update type, "time-mixed", [[[value, time, importance], ...] per key]]
+  qi::AnyReferenceVector fields = asList(commands.asReference());
+  if ((fields.size() < 4) || (unwrap(fields[2]).toString() != "time-mixed"))
+    throw std::runtime_error("DCM: only the time-mixed commands are simulated");
+
+  std::vector <std::string> keys;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map <std::string, std::vector <std::string> >::const_iterator it = aliases_.find(unwrap(fields[0]).toString());
+    if (it == aliases_.end())
+      throw std::runtime_error("DCM: unknown alias " + unwrap(fields[0]).toString());
+    keys = it->second;
+  }
+
+  // the last point of each key is applied at once
+  qi::AnyReferenceVector values = asList(fields[3]);
+  for (size_t i=0; (i<values.size()) && (i<keys.size()); ++i)
+  {
+    qi::AnyReferenceVector points = asList(values[i]);
+    if (!points.empty())
+      robot_->setActuator(keys[i], unwrap(asList(points.back())[0]).toFloat());
+  }
+}
+
+void FakeDCM::set(const qi::AnyValue &command)
+{
+  robot_->rpc("DCM.set");
+
+  // [alias, update type, [[value, time], ...]]
+  qi::AnyReferenceVector fields = asList(command.asReference());
+  if (fields.size() < 3)
+    throw std::runtime_error("DCM: invalid command");
+
+  std::vector <std::string> keys;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    std::map <std::string, std::vector <std::string> >::const_iterator it = aliases_.find(unwrap(fields[0]).toString());
+    if (it == aliases_.end())
+      throw std::runtime_error("DCM: unknown alias " + unwrap(fields[0]).toString());
+    keys = it->second;
+  }
+
+  qi::AnyReferenceVector points = asList(fields[2]);
+  if (points.empty())
+    return;
+  const float value = unwrap(asList(points.back())[0]).toFloat();
+  for (size_t i=0; i<keys.size(); ++i)
+    robot_->setActuator(keys[i], value);
+}
+
+int FakeDCM::getTime(const int &offset)
+{
+  robot_->rpc("DCM.getTime");
+  return static_cast<int>((qi::os::ustime() - start_)/1000) + offset;
+}
+
+FakeBodyTemperature::FakeBodyTemperature(const boost::shared_ptr <FakeRobot> &robot):
+  robot_(robot)
+{
+}
+
+void FakeBodyTemperature::setEnableNotifications(const bool &enabled)
+{
+  robot_->rpc("ALBodyTemperature.setEnableNotifications");
+}
+
+FakeTouch::FakeTouch(const boost::shared_ptr <FakeRobot> &robot):
+  robot_(robot)
+{
+}
+
+void FakeTouch::exit()
+{
+  robot_->rpc("ALTouch.exit");
+}
+
+FakeAutonomousLife::FakeAutonomousLife(const boost::shared_ptr <FakeRobot> &robot):
+  robot_(robot),
+  state_("solitary")
+{
+}
+
+std::string FakeAutonomousLife::getState()
+{
+  robot_->rpc("ALAutonomousLife.getState");
+  boost::mutex::scoped_lock lock(mutex_);
+  return state_;
+}
+
+void FakeAutonomousLife::setState(const std::string &state)
+{
+  robot_->rpc("ALAutonomousLife.setState");
+  boost::mutex::scoped_lock lock(mutex_);
+  state_ = state;
+}
+
+bool registerFakeServices(const qi::SessionPtr &session,
+                          const boost::shared_ptr <FakeRobot> &robot)
+{
+  try
+  {
+    session->registerService("ALMemory", boost::make_shared<FakeMemory>(robot)).value();
+    session->registerService("ALMotion", boost::make_shared<FakeMotion>(robot)).value();
+    session->registerService("DCM", boost::make_shared<FakeDCM>(robot)).value();
+    session->registerService("ALBodyTemperature", boost::make_shared<FakeBodyTemperature>(robot)).value();
+    session->registerService("ALTouch", boost::make_shared<FakeTouch>(robot)).value();
+    session->registerService("ALAutonomousLife", boost::make_shared<FakeAutonomousLife>(robot)).value();
+  }
+  catch (const std::exception& e)
+  {
+    ROS_ERROR("Could not register the stand-in services!\n\tTrace: %s", e.what());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#include <ros/ros.h>
+
+#include "naoqi_dcm_driver/flight_recorder.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+
+/*
+ * File layout, integers in host byte order:
+ *   magic, format version, reason, dump time (monotonic), dump time (ROS),
+ *   joints count, joints names, stages count, stages names,
+ *   ticks count, then per tick: number, time, flags, stages durations [ns],
+ *     then per joint: position, command, velocity command, effort,
+ *   methods count, methods names,
+ *   calls count, then per call: method index, start, end, status
+ * a string is its length followed by its characters, the times are in ns
+ */
+static const boost::uint32_t MAGIC = 0x4644434e; // "NCDF"
+static const boost::uint32_t FORMAT_VERSION = 1;
+
+//! @brief check that the stream still holds count records of size bytes
+static bool checkCount(std::istream &in, const boost::uint32_t &count, const size_t &size)
+{
+  const std::streampos position = in.tellg();
+  in.seekg(0, std::ios::end);
+  const std::streampos end = in.tellg();
+  in.seekg(position);
+  return in && (end >= position)
+      && (static_cast<boost::uint64_t>(count)*size <= static_cast<boost::uint64_t>(end - position));
+}
+
+FlightRecorder::FlightRecorder():
+  ticks_capacity_(0),
+  rpcs_capacity_(0),
+  ticks_head_(0),
+  rpcs_head_(0),
+  enabled_(false)
+{
+}
+
+FlightRecorder& FlightRecorder::instance()
+{
+  static FlightRecorder recorder;
+  return recorder;
+}
+
+void FlightRecorder::enable(const size_t &ticks,
+                            const std::vector <std::string> &joints,
+                            const size_t &rpcs)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if ((ticks == 0) || (rpcs == 0))
+    return;
+
+  // a reconnection keeps the previous ticks if nothing changed
+  if (!ticks_ || (ticks != ticks_capacity_) || (joints != joints_))
+  {
+    joints_ = joints;
+    ticks_.reset(new TickSlot[ticks]);
+    values_.reset(new float[ticks*joints.size()*VALUES]);
+    for (size_t i=0; i<ticks; ++i)
+      ticks_[i].sequence.store(0, boost::memory_order_relaxed);
+    ticks_capacity_ = ticks;
+    ticks_head_ = 0;
+  }
+
+  if (!rpcs_)
+  {
+    rpcs_.reset(new RpcSlot[rpcs]);
+    for (size_t i=0; i<rpcs; ++i)
+      rpcs_[i].sequence.store(0, boost::memory_order_relaxed);
+    rpcs_capacity_ = rpcs;
+  }
+
+  enabled_.store(true, boost::memory_order_release);
+}
+
+void FlightRecorder::recordTick(const boost::uint64_t *durations,
+                                const boost::uint32_t &flags,
+                                const std::vector <double> &positions,
+                                const std::vector <double> &commands,
+                                const std::vector <double> &velocity_commands,
+                                const std::vector <double> &efforts)
+{
+  if (!isEnabled())
+    return;
+
+  const boost::uint64_t index = ticks_head_++;
+  const size_t slot = index % ticks_capacity_;
+  TickSlot &tick = ticks_[slot];
+
+  // the dumps skip the slot until its sequence is set again
+  tick.sequence.store(0, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+  tick.time = monotonicNs();
+  tick.flags = flags;
+  for (int i=0; i<LoopStats::STAGES; ++i)
+    tick.durations[i] = static_cast<boost::uint32_t>(std::min(durations[i], static_cast<boost::uint64_t>(0xffffffff)));
+
+  float *values = &values_[slot*joints_.size()*VALUES];
+  for (size_t j=0; j<joints_.size(); ++j, values += VALUES)
+  {
+    values[POSITION] = (j < positions.size()) ? positions[j] : 0.0f;
+    values[COMMAND] = (j < commands.size()) ? commands[j] : 0.0f;
+    values[VELOCITY_COMMAND] = (j < velocity_commands.size()) ? velocity_commands[j] : 0.0f;
+    values[EFFORT] = (j < efforts.size()) ? efforts[j] : 0.0f;
+  }
+  tick.sequence.store(index + 1, boost::memory_order_release);
+}
+
+void FlightRecorder::recordRpc(const std::string *method,
+                               const boost::uint64_t &start,
+                               const boost::uint64_t &end,
+                               const Status &status)
+{
+  if (!isEnabled())
+    return;
+
+  const boost::uint64_t index = rpcs_head_.fetch_add(1, boost::memory_order_relaxed);
+  RpcSlot &rpc = rpcs_[index % rpcs_capacity_];
+
+  rpc.sequence.store(0, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+  rpc.method = method;
+  rpc.start = start;
+  rpc.end = end;
+  rpc.status = status;
+  rpc.sequence.store(index + 1, boost::memory_order_release);
+}
+
+bool FlightRecorder::dump(const std::string &path, const std::string &reason)
+{
+  if (!isEnabled() || path.empty())
+    return false;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  const size_t joint_values = joints_.size()*VALUES;
+
+  // copy the consistent slots, the writers keep going meanwhile
+  std::map <boost::uint64_t, Tick> ticks;
+  for (size_t i=0; i<ticks_capacity_; ++i)
+  {
+    const TickSlot &slot = ticks_[i];
+    const boost::uint64_t sequence = slot.sequence.load(boost::memory_order_acquire);
+    Tick tick;
+    tick.number = sequence - 1;
+    tick.time = slot.time;
+    tick.flags = slot.flags;
+    tick.durations.assign(slot.durations, slot.durations + LoopStats::STAGES);
+    tick.values.assign(&values_[i*joint_values], &values_[i*joint_values] + joint_values);
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    if ((sequence != 0) && (sequence == slot.sequence.load(boost::memory_order_relaxed)))
+      ticks[tick.number] = tick;
+  }
+
+  std::map <boost::uint64_t, RpcSlot*> rpcs;
+  std::vector <RpcSlot> rpcs_copy(rpcs_capacity_);
+  for (size_t i=0; i<rpcs_capacity_; ++i)
+  {
+    const RpcSlot &slot = rpcs_[i];
+    const boost::uint64_t sequence = slot.sequence.load(boost::memory_order_acquire);
+    RpcSlot &rpc = rpcs_copy[i];
+    rpc.method = slot.method;
+    rpc.start = slot.start;
+    rpc.end = slot.end;
+    rpc.status = slot.status;
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    if ((sequence != 0) && (sequence == slot.sequence.load(boost::memory_order_relaxed)))
+      rpcs[sequence] = &rpc;
+  }
+
+  // the methods are written once, the calls refer to them by index
+  std::vector <std::string> methods;
+  std::map <const std::string*, boost::uint32_t> methods_indexes;
+  for (std::map<boost::uint64_t, RpcSlot*>::const_iterator it = rpcs.begin(); it != rpcs.end(); ++it)
+    if (methods_indexes.insert(std::make_pair(it->second->method, methods.size())).second)
+      methods.push_back(*it->second->method);
+
+  std::vector <std::string> stages(LoopStats::STAGES);
+  for (int i=0; i<LoopStats::STAGES; ++i)
+    stages[i] = LoopStats::getStageName(static_cast<LoopStats::Stage>(i));
+
+  std::ofstream out;
+  if (!openTemporaryFile(path, &out))
+  {
+    ROS_ERROR_STREAM("Could not write the flight recorder to " << path);
+    return false;
+  }
+
+  writeValue(out, MAGIC);
+  writeValue(out, FORMAT_VERSION);
+  writeString(out, reason);
+  writeValue(out, monotonicNs());
+  writeValue(out, static_cast<boost::uint64_t>(ros::Time::now().toNSec()));
+  writeStrings(out, joints_);
+  writeStrings(out, stages);
+
+  writeValue(out, static_cast<boost::uint32_t>(ticks.size()));
+  for (std::map<boost::uint64_t, Tick>::const_iterator it = ticks.begin(); it != ticks.end(); ++it)
+  {
+    const Tick &tick = it->second;
+    writeValue(out, tick.number);
+    writeValue(out, tick.time);
+    writeValue(out, tick.flags);
+    out.write(reinterpret_cast<const char*>(&tick.durations[0]), tick.durations.size()*sizeof(boost::uint32_t));
+    if (!tick.values.empty())
+      out.write(reinterpret_cast<const char*>(&tick.values[0]), tick.values.size()*sizeof(float));
+  }
+
+  writeStrings(out, methods);
+  writeValue(out, static_cast<boost::uint32_t>(rpcs.size()));
+  for (std::map<boost::uint64_t, RpcSlot*>::const_iterator it = rpcs.begin(); it != rpcs.end(); ++it)
+  {
+    writeValue(out, methods_indexes[it->second->method]);
+    writeValue(out, it->second->start);
+    writeValue(out, it->second->end);
+    writeValue(out, it->second->status);
+  }
+
+  if (!replaceFile(path, &out))
+  {
+    ROS_ERROR_STREAM("Could not write the flight recorder to " << path);
+    return false;
+  }
+
+  ROS_INFO("Flight recorder (%s): %lu ticks and %lu calls written to %s", reason.c_str(),
+           static_cast<unsigned long>(ticks.size()), static_cast<unsigned long>(rpcs.size()),
+           path.c_str());
+  return true;
+}
+
+bool FlightRecorder::load(const std::string &path, Recording *recording)
+{
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in)
+    return false;
+
+  boost::uint32_t magic(0), format(0), count(0);
+  if (!readValue(in, &magic) || (magic != MAGIC)
+      || !readValue(in, &format) || (format != FORMAT_VERSION)
+      || !readString(in, &recording->reason)
+      || !readValue(in, &recording->time)
+      || !readValue(in, &recording->ros_time)
+      || !readStrings(in, &recording->joints)
+      || !readStrings(in, &recording->stages)
+      || !readValue(in, &count))
+    return false;
+
+  const size_t joint_values = recording->joints.size()*VALUES;
+  if (!checkCount(in, count, 2*sizeof(boost::uint64_t) + sizeof(boost::uint32_t)
+                  + recording->stages.size()*sizeof(boost::uint32_t) + joint_values*sizeof(float)))
+    return false;
+  recording->ticks.resize(count);
+  for (boost::uint32_t i=0; i<count; ++i)
+  {
+    Tick &tick = recording->ticks[i];
+    tick.durations.resize(recording->stages.size());
+    tick.values.resize(joint_values);
+    if (!readValue(in, &tick.number) || !readValue(in, &tick.time) || !readValue(in, &tick.flags)
+        || (!tick.durations.empty()
+            && !in.read(reinterpret_cast<char*>(&tick.durations[0]), tick.durations.size()*sizeof(boost::uint32_t)))
+        || (!tick.values.empty()
+            && !in.read(reinterpret_cast<char*>(&tick.values[0]), tick.values.size()*sizeof(float))))
+      return false;
+  }
+
+  std::vector <std::string> methods;
+  if (!readStrings(in, &methods) || !readValue(in, &count)
+      || !checkCount(in, count, 2*sizeof(boost::uint32_t) + 2*sizeof(boost::uint64_t)))
+    return false;
+
+  recording->rpcs.resize(count);
+  for (boost::uint32_t i=0; i<count; ++i)
+  {
+    Rpc &rpc = recording->rpcs[i];
+    boost::uint32_t method(0);
+    if (!readValue(in, &method) || (method >= methods.size())
+        || !readValue(in, &rpc.start) || !readValue(in, &rpc.end) || !readValue(in, &rpc.status))
+      return false;
+    rpc.method = methods[method];
+  }
+  return true;
+}
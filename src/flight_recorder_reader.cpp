@@ -0,0 +1,130 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "naoqi_dcm_driver/flight_recorder.hpp"
+
+/*
+ * Print a flight recorder dump as CSV tables, the times in ms before the dump:
+ *   naoqi_dcm_driver_flight_reader <dump> [ticks|rpcs|summary]
+ */
+
+static const char *STATUSES[3] = {"ok", "error", "timeout"};
+static const char *VALUES[FlightRecorder::VALUES] = {"position", "command", "velocity_command", "effort"};
+
+static double toMs(const boost::uint64_t &time, const boost::uint64_t &reference)
+{
+  return (static_cast<double>(time) - static_cast<double>(reference))*1e-6;
+}
+
+static void printSummary(const FlightRecorder::Recording &recording)
+{
+  printf("reason: %s\n", recording.reason.c_str());
+  printf("ROS time of the dump: %.3f\n", recording.ros_time*1e-9);
+  printf("joints: %lu\n", static_cast<unsigned long>(recording.joints.size()));
+
+  if (!recording.ticks.empty())
+  {
+    size_t unread = 0, sent = 0;
+    for (size_t i=0; i<recording.ticks.size(); ++i)
+    {
+      unread += (recording.ticks[i].flags & FlightRecorder::READ) ? 0 : 1;
+      sent += (recording.ticks[i].flags & FlightRecorder::SENT) ? 1 : 0;
+    }
+    printf("ticks: %lu, from %lu to %lu, %.1f ms to %.1f ms\n",
+           static_cast<unsigned long>(recording.ticks.size()),
+           static_cast<unsigned long>(recording.ticks.front().number),
+           static_cast<unsigned long>(recording.ticks.back().number),
+           toMs(recording.ticks.front().time, recording.time),
+           toMs(recording.ticks.back().time, recording.time));
+    printf("ticks without read: %lu, with commands sent: %lu\n",
+           static_cast<unsigned long>(unread), static_cast<unsigned long>(sent));
+  }
+
+  size_t failed = 0;
+  for (size_t i=0; i<recording.rpcs.size(); ++i)
+    failed += (recording.rpcs[i].status != FlightRecorder::OK) ? 1 : 0;
+  printf("calls: %lu, failed: %lu\n",
+         static_cast<unsigned long>(recording.rpcs.size()), static_cast<unsigned long>(failed));
+}
+
+static void printTicks(const FlightRecorder::Recording &recording)
+{
+  printf("tick,time_ms,read,sent");
+  for (size_t i=0; i<recording.stages.size(); ++i)
+    printf(",%s_us", recording.stages[i].c_str());
+  for (size_t j=0; j<recording.joints.size(); ++j)
+    for (int k=0; k<FlightRecorder::VALUES; ++k)
+      printf(",%s/%s", recording.joints[j].c_str(), VALUES[k]);
+  printf("\n");
+
+  for (size_t i=0; i<recording.ticks.size(); ++i)
+  {
+    const FlightRecorder::Tick &tick = recording.ticks[i];
+    printf("%lu,%.3f,%d,%d", static_cast<unsigned long>(tick.number), toMs(tick.time, recording.time),
+           (tick.flags & FlightRecorder::READ) ? 1 : 0, (tick.flags & FlightRecorder::SENT) ? 1 : 0);
+    for (size_t k=0; k<tick.durations.size(); ++k)
+      printf(",%.1f", tick.durations[k]*1e-3);
+    for (size_t k=0; k<tick.values.size(); ++k)
+      printf(",%g", tick.values[k]);
+    printf("\n");
+  }
+}
+
+static void printRpcs(const FlightRecorder::Recording &recording)
+{
+  printf("method,start_ms,latency_us,status\n");
+  for (size_t i=0; i<recording.rpcs.size(); ++i)
+  {
+    const FlightRecorder::Rpc &rpc = recording.rpcs[i];
+    printf("%s,%.3f,%.1f,%s\n", rpc.method.c_str(), toMs(rpc.start, recording.time),
+           (rpc.end - rpc.start)*1e-3, (rpc.status < 3) ? STATUSES[rpc.status] : "unknown");
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if ((argc < 2) || (argc > 3))
+  {
+    std::cerr << "Usage: " << argv[0] << " <dump> [ticks|rpcs|summary]" << std::endl;
+    return 1;
+  }
+
+  FlightRecorder::Recording recording;
+  if (!FlightRecorder::load(argv[1], &recording))
+  {
+    std::cerr << "Could not read the flight recorder dump " << argv[1] << std::endl;
+    return 1;
+  }
+
+  const std::string table = (argc == 3) ? argv[2] : "summary";
+  if (table == "ticks")
+    printTicks(recording);
+  else if (table == "rpcs")
+    printRpcs(recording);
+  else if (table == "summary")
+    printSummary(recording);
+  else
+  {
+    std::cerr << "Unknown table " << table << ", expected ticks, rpcs or summary" << std::endl;
+    return 1;
+  }
+  return 0;
+}
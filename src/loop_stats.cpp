@@ -0,0 +1,141 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <string>
+
+#include "naoqi_dcm_driver/loop_stats.hpp"
+#include "naoqi_dcm_driver/probes.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+#include "naoqi_dcm_driver/tracer.hpp"
+
+namespace
+{
+const char *STAGES_NAMES[LoopStats::STAGES] = {"odometry", "diagnostics", "read", "update", "write",
+                                               "stiffness", "statistics", "joint_states", "sensors",
+                                               "sleep"};
+
+/** columns of a row */
+const int COLUMNS = 7;
+}
+
+LoopStats::LoopStats(const double &period):
+  budget_(static_cast<boost::uint64_t>(period*1e9)),
+  tick_start_(0),
+  last_mark_(0),
+  ticks_(0),
+  tick_overruns_(0)
+{
+  std::fill(durations_, durations_ + STAGES, 0);
+  std::fill(overruns_, overruns_ + STAGES, 0);
+}
+
+void LoopStats::startTick()
+{
+  const boost::uint64_t now = monotonicNs();
+  NAOQI_DCM_PROBE2(tick, ticks_, (tick_start_ != 0) ? now - tick_start_ : 0);
+  ++ticks_;
+
+  if (tick_start_ != 0)
+  {
+    // the work is everything before the sleep
+    const boost::uint64_t work = last_mark_ - tick_start_;
+    durations_[SLEEP] = now - last_mark_;
+    stages_[SLEEP].record(durations_[SLEEP]);
+    tick_.record(now - tick_start_);
+    Tracer::instance().record("loop", STAGES_NAMES[SLEEP], last_mark_, now);
+    Tracer::instance().record("loop", "tick", tick_start_, last_mark_);
+
+    if (work > budget_)
+    {
+      ++tick_overruns_;
+      ++overruns_[std::max_element(durations_, durations_ + SLEEP) - durations_];
+    }
+  }
+  else
+    durations_[SLEEP] = 0;
+
+  // the sleep before the tick is kept with its stages
+  std::fill(durations_, durations_ + SLEEP, 0);
+  tick_start_ = now;
+  last_mark_ = now;
+}
+
+void LoopStats::mark(const Stage &stage)
+{
+  if (tick_start_ == 0)
+    return;
+
+  const boost::uint64_t now = monotonicNs();
+  durations_[stage] += now - last_mark_;
+  stages_[stage].record(now - last_mark_);
+  Tracer::instance().record("loop", STAGES_NAMES[stage], last_mark_, now);
+  last_mark_ = now;
+}
+
+const boost::uint64_t* LoopStats::getDurations() const
+{
+  return durations_;
+}
+
+const char* LoopStats::getStageName(const Stage &stage)
+{
+  return STAGES_NAMES[stage];
+}
+
+void LoopStats::cancelTick()
+{
+  tick_start_ = 0;
+}
+
+void LoopStats::fill(std_msgs::Float32MultiArray *msg)
+{
+  //the layout never changes, it is only written once
+  if (msg->layout.dim.size() != 2)
+  {
+    std::string rows;
+    for (int i=0; i<STAGES; ++i)
+      rows += std::string(STAGES_NAMES[i]) + " ";
+    rows += "tick";
+
+    msg->layout.dim.resize(2);
+    msg->layout.dim[0].label = rows;
+    msg->layout.dim[0].size = STAGES + 1;
+    msg->layout.dim[0].stride = (STAGES + 1)*COLUMNS;
+    msg->layout.dim[1].label = "count mean_us p50_us p90_us p99_us max_us overruns";
+    msg->layout.dim[1].size = COLUMNS;
+    msg->layout.dim[1].stride = COLUMNS;
+    msg->data.resize((STAGES + 1)*COLUMNS, 0.0f);
+  }
+
+  std::vector<float>::iterator it = msg->data.begin();
+  for (int i=0; i<=STAGES; ++i)
+  {
+    LatencyHistogram &histogram = (i < STAGES) ? stages_[i] : tick_;
+    *it++ = static_cast<float>(histogram.getCount());
+    *it++ = static_cast<float>(histogram.getMean()*1e-3);
+    *it++ = static_cast<float>(histogram.getPercentile(0.5)*1e-3);
+    *it++ = static_cast<float>(histogram.getPercentile(0.9)*1e-3);
+    *it++ = static_cast<float>(histogram.getPercentile(0.99)*1e-3);
+    *it++ = static_cast<float>(histogram.getMax()*1e-3);
+    *it++ = static_cast<float>((i < STAGES) ? overruns_[i] : tick_overruns_);
+    histogram.reset();
+  }
+
+  std::fill(overruns_, overruns_ + STAGES, 0);
+  tick_overruns_ = 0;
+}
@@ -19,23 +19,42 @@
 #include <ros/ros.h>
 
 #include "naoqi_dcm_driver/memory.hpp"
+#include "naoqi_dcm_driver/probes.hpp"
 #include "naoqi_dcm_driver/tools.hpp"
 
-Memory::Memory(const qi::SessionPtr& session)
+Memory::Memory(const qi::AnyObject& proxy):
+  memory_proxy_(proxy),
+  tick_(0)
 {
-  try
-  {
-    memory_proxy_ = session->service("ALMemory").value();
-  }
-  catch (const std::exception& e)
-  {
-    ROS_ERROR("Memory: Failed to connect to Memory Proxy!\n\tTrace: %s", e.what());
-  }
+  // the joints positions are always the first group
+  addKeysGroup(std::vector <std::string>());
+
 }
 
 void Memory::init(const std::vector <std::string> &joints_names)
 {
-  keys_positions_ = initMemoryKeys(joints_names);
+  std::vector <std::string> keys = initMemoryKeys(joints_names);
+
+  keys_all_.clear();
+  for(int i=0; i<joints_names.size(); ++i)
+    keys_all_[joints_names.at(i)] = keys.at(i);
+
+  setKeysGroup(0, keys);
+}
+
+void Memory::setJoints(const std::vector <std::string> &joints_names)
+{
+  std::vector <std::string> keys;
+  keys.reserve(joints_names.size());
+  for(std::vector<std::string>::const_iterator it=joints_names.begin(); it!=joints_names.end(); ++it)
+  {
+    std::map<std::string, std::string>::const_iterator key = keys_all_.find(*it);
+    if (key != keys_all_.end())
+      keys.push_back(key->second);
+    else
+      keys.push_back(initMemoryKeys(std::vector<std::string>(1, *it)).at(0));
+  }
+  setKeysGroup(0, keys);
 }
 
 std::vector <std::string> Memory::initMemoryKeys(const std::vector <std::string> &joints)
@@ -50,16 +69,106 @@ std::vector <std::string> Memory::initMemoryKeys(const std::vector <std::string>
 
 std::vector<float> Memory::getListData()
 {
-  return getListData(keys_positions_);
+  return getListData(groups_[0].keys);
+}
+
+int Memory::addKeysGroup(const std::vector <std::string> &keys,
+                         const int &decimation)
+{
+  KeysGroup group;
+  group.keys = keys;
+  group.decimation = decimation;
+  group.updated = false;
+  group.offset = 0;
+  groups_.push_back(group);
+  due_.push_back(false);
+
+  keys_cache_.clear();
+  return groups_.size() - 1;
+}
+
+void Memory::setKeysGroup(const int &id, const std::vector <std::string> &keys)
+{
+  groups_.at(id).keys = keys;
+  keys_cache_.clear();
+}
+
+bool Memory::update()
+{
+  // find the groups due at this tick and their offsets
+  size_t offset = 0;
+  for (int i=0; i<groups_.size(); ++i)
+  {
+    KeysGroup &group = groups_[i];
+    due_[i] = (group.decimation > 0) && (tick_ % group.decimation == 0);
+    group.updated = false;
+    group.offset = offset;
+    if (due_[i])
+      offset += group.keys.size();
+  }
+  ++tick_;
+
+  // concatenate the keys once per combination of due groups
+  std::map<std::vector<bool>, std::vector<std::string> >::iterator it = keys_cache_.find(due_);
+  if (it == keys_cache_.end())
+  {
+    std::vector <std::string> keys;
+    keys.reserve(offset);
+    for (int i=0; i<groups_.size(); ++i)
+      if (due_[i])
+        keys.insert(keys.end(), groups_[i].keys.begin(), groups_[i].keys.end());
+    it = keys_cache_.insert(std::make_pair(due_, keys)).first;
+  }
+
+  if (!it->second.empty())
+  {
+    try
+    {
+      NAOQI_DCM_PROBE_SCOPE(memory_get_list_data);
+      static RpcStats::Method *const get_list_data_rpc = RpcStats::instance().get("getListData");
+      qi::AnyValue values_qi = memory_proxy_.call<qi::AnyValue>(get_list_data_rpc, it->second);
+      fromAnyValueToFloatVector(values_qi, &values_);
+    }
+    catch(const std::exception& e)
+    {
+      ROS_ERROR("Memory: Could not read data from Memory Proxy \n\tTrace: %s", e.what());
+      return false;
+    }
+
+    if (values_.size() != it->second.size())
+    {
+      ROS_ERROR("Memory: Read %lu values instead of %lu", values_.size(), it->second.size());
+      return false;
+    }
+  }
+
+  for (int i=0; i<groups_.size(); ++i)
+    groups_[i].updated = due_[i];
+  return true;
+}
+
+bool Memory::isKeysGroupUpdated(const int &id) const
+{
+  return groups_.at(id).updated;
+}
+
+const float* Memory::getKeysGroupData(const int &id) const
+{
+  const KeysGroup &group = groups_.at(id);
+  if (!group.updated || group.keys.empty())
+    return NULL;
+  return &values_[group.offset];
 }
 
 std::vector<float> Memory::getListData(const std::vector <std::string> &keys)
 {
+  NAOQI_DCM_PROBE_SCOPE(memory_get_list_data);
   qi::AnyValue keys_qi;
 
   try
   {
-    keys_qi = memory_proxy_.call<qi::AnyValue>("getListData", keys);
+    static RpcStats::Method *const get_list_data_rpc = RpcStats::instance().get("getListData");
+    keys_qi = memory_proxy_.call<qi::AnyValue>(get_list_data_rpc, keys);
   }
   catch(const std::exception& e)
   {
@@ -75,7 +184,8 @@ std::string Memory::getData(const std::string &str)
   std::string res;
   try
   {
-    res = memory_proxy_.call<std::string>("getData", str);
+    static RpcStats::Method *const get_data_rpc = RpcStats::instance().get("getData");
+    res = memory_proxy_.call<std::string>(get_data_rpc, str);
   }
   catch (const std::exception& e)
   {
@@ -84,6 +194,24 @@ std::string Memory::getData(const std::string &str)
   return res;
 }
 
+void Memory::setProxy(const qi::AnyObject& proxy)
+{
+  memory_proxy_ = proxy;
+}
+
+qi::Future <std::string> Memory::getDataAsync(const std::string &str)
+{
+  try
+  {
+    static RpcStats::Method *const get_data_rpc = RpcStats::instance().get("getData");
+    return memory_proxy_.async<std::string>(get_data_rpc, str);
+  }
+  catch (const std::exception& e)
+  {
+    return qi::makeFutureError<std::string>(e.what());
+  }
+}
+
 void Memory::subscribeToMicroEvent(const std::string &name,
                                    const std::string &callback_module,
                                    const std::string &callback_method,
@@ -91,7 +219,9 @@ void Memory::subscribeToMicroEvent(const std::string &name,
 {
   try
   {
-    memory_proxy_.call<int>("subscribeToMicroEvent", name, callback_module, callback_message, callback_method);
+    static RpcStats::Method *const subscribe_to_micro_event_rpc =
+        RpcStats::instance().get("subscribeToMicroEvent");
+    memory_proxy_.call<int>(subscribe_to_micro_event_rpc, name, callback_module, callback_message, callback_method);
   }
   catch(const std::exception& e)
   {
@@ -104,7 +234,9 @@ void Memory::unsubscribeFromMicroEvent(const std::string &name,
 {
   try
   {
-    memory_proxy_.call<void>("unsubscribeToMicroEvent", name, callback_module);
+    static RpcStats::Method *const unsubscribe_to_micro_event_rpc =
+        RpcStats::instance().get("unsubscribeToMicroEvent");
+    memory_proxy_.call<void>(unsubscribe_to_micro_event_rpc, name, callback_module);
   }
   catch(const std::exception& e)
   {
@@ -18,49 +18,46 @@
 // ROS Headers
 #include <ros/ros.h>
 
+#include <boost/bind.hpp>
+
 #include "naoqi_dcm_driver/motion.hpp"
 #include "naoqi_dcm_driver/tools.hpp"
 
-Motion::Motion(const qi::SessionPtr& session)
+Motion::Motion(const qi::AnyObject& proxy):
+  motion_proxy_(proxy)
 {
-  try
-  {
-    motion_proxy_ = session->service("ALMotion").value();
-  }
-  catch (const std::exception& e)
-  {
-    ROS_ERROR("Motion: Failed to connect to Motion Proxy!\n\tTrace: %s", e.what());
-  }
+}
 
-  //set walk arms enabled / disabled
-  try
-  {
-    motion_proxy_.call<void>("setMoveArmsEnabled", 0, 0);
-  }
-  catch (const std::exception& e)
-  {
-    ROS_WARN("Motion: Failed to set move arms enabled!\n\tTrace: %s", e.what());
-  }
+void Motion::setProxy(const qi::AnyObject& proxy)
+{
+  motion_proxy_ = proxy;
+  position_future_ = qi::Future< std::vector<float> >();
+  velocity_future_ = qi::Future< std::vector<float> >();
+}
 
-  //set external collision protection of the robot
+std::vector <qi::Future <void> > Motion::configure()
+{
+  std::vector <qi::Future <void> > res;
   try
   {
-    motion_proxy_.call<void>("setExternalCollisionProtectionEnabled", "Arms", 0);
-  }
-  catch (const std::exception& e)
-  {
-    ROS_WARN("Motion: Failed to set external collision protection!\n\tTrace: %s", e.what());
-  }
+    //set walk arms enabled / disabled
+    static RpcStats::Method *const set_move_arms_enabled_rpc = RpcStats::instance().get("setMoveArmsEnabled");
+    res.push_back(motion_proxy_.async<void>(set_move_arms_enabled_rpc, 0, 0));
 
-  //set Smart Stiffness
-  try
-  {
-    motion_proxy_.call<void>("setSmartStiffnessEnabled", 1);
+    //set external collision protection of the robot
+    static RpcStats::Method *const set_external_collision_protection_enabled_rpc =
+        RpcStats::instance().get("setExternalCollisionProtectionEnabled");
+    res.push_back(motion_proxy_.async<void>(set_external_collision_protection_enabled_rpc, "Arms", 0));
+
+    //set Smart Stiffness
+    static RpcStats::Method *const set_smart_stiffness_enabled_rpc = RpcStats::instance().get("setSmartStiffnessEnabled");
+    res.push_back(motion_proxy_.async<void>(set_smart_stiffness_enabled_rpc, 1));
   }
   catch (const std::exception& e)
   {
-    ROS_WARN("Motion: Failed to set smart stiffness!\n\tTrace: %s", e.what());
+    ROS_WARN("Motion: Failed to configure the motion!\n\tTrace: %s", e.what());
   }
+  return res;
 }
 
 void Motion::init(const std::vector <std::string> &joints_names)
@@ -73,7 +70,8 @@ bool Motion::robotIsWakeUp()
   bool res(false);
   try
   {
-    if (motion_proxy_.call<bool>("robotIsWakeUp"))
+    static RpcStats::Method *const robot_is_wake_up_rpc = RpcStats::instance().get("robotIsWakeUp");
+    if (motion_proxy_.call<bool>(robot_is_wake_up_rpc))
       res = true;
   }
   catch (const std::exception& e)
@@ -90,8 +88,12 @@ void Motion::wakeUp()
     if (!robotIsWakeUp())
     {
       ROS_INFO_STREAM("Going to wakeup ...");
-      motion_proxy_.call<void>("wakeUp");
-      ros::Duration(3.0).sleep();
+      static RpcStats::Method *const wake_up_rpc = RpcStats::instance().get("wakeUp");
+      motion_proxy_.call<void>(wake_up_rpc);
+
+      // wakeUp returns with the posture reached, only wait for the stiffness to be reported
+      if (!waitFor(boost::bind(&Motion::robotIsWakeUp, this), 3.0))
+        ROS_WARN("Motion: The robot did not report being awake in time");
     }
   }
   catch (const std::exception& e)
@@ -104,11 +106,15 @@ void Motion::rest()
 {
   try
   {
-    if (motion_proxy_.call<bool>("robotIsWakeUp"))
+    static RpcStats::Method *const robot_is_wake_up_rpc = RpcStats::instance().get("robotIsWakeUp");
+    if (motion_proxy_.call<bool>(robot_is_wake_up_rpc))
     {
       ROS_INFO_STREAM("Going to rest ...");
-      motion_proxy_.call<void>("rest");
-      sleep(4);
+      static RpcStats::Method *const rest_rpc = RpcStats::instance().get("rest");
+      motion_proxy_.call<void>(rest_rpc);
+
+      if (!waitFor(!boost::bind(&Motion::robotIsWakeUp, this), 4.0))
+        ROS_WARN("Motion: The robot did not report being at rest in time");
     }
   }
   catch (const std::exception& e)
@@ -122,7 +128,8 @@ std::vector <std::string> Motion::getBodyNames(const std::string &robot_part)
   std::vector <std::string> joints;
   try
   {
-    joints = motion_proxy_.call< std::vector<std::string> >("getBodyNames", robot_part);
+    static RpcStats::Method *const get_body_names_rpc = RpcStats::instance().get("getBodyNames");
+    joints = motion_proxy_.call< std::vector<std::string> >(get_body_names_rpc, robot_part);
   }
   catch (const std::exception& e)
   {
@@ -132,6 +139,19 @@ std::vector <std::string> Motion::getBodyNames(const std::string &robot_part)
   return joints;
 }
 
+qi::Future <std::vector <std::string> > Motion::getBodyNamesAsync(const std::string &robot_part)
+{
+  try
+  {
+    static RpcStats::Method *const get_body_names_rpc = RpcStats::instance().get("getBodyNames");
+    return motion_proxy_.async< std::vector<std::string> >(get_body_names_rpc, robot_part);
+  }
+  catch (const std::exception& e)
+  {
+    return qi::makeFutureError< std::vector<std::string> >(e.what());
+  }
+}
+
 std::vector <std::string> Motion::getBodyNamesFromGroup(const std::vector<std::string> &motor_groups)
 {
   std::vector <std::string> res;
@@ -146,48 +166,90 @@ std::vector <std::string> Motion::getBodyNamesFromGroup(const std::vector<std::s
 
 void Motion::manageConcurrence()
 {
-  //set Smart Stiffness
   try
   {
-    motion_proxy_.call<void>("setSmartStiffnessEnabled", 0);
+    //set Smart Stiffness and PushRecoveryEnabled together
+    static RpcStats::Method *const set_smart_stiffness_enabled_rpc = RpcStats::instance().get("setSmartStiffnessEnabled");
+    qi::Future<void> smart_stiffness = motion_proxy_.async<void>(set_smart_stiffness_enabled_rpc, 0);
+    static RpcStats::Method *const set_push_recovery_enabled_rpc = RpcStats::instance().get("setPushRecoveryEnabled");
+    qi::Future<void> push_recovery = motion_proxy_.async<void>(set_push_recovery_enabled_rpc, 0);
+
+    // this runs on the loop thread, a stalled call is canceled at the rpc deadline
+    const boost::uint64_t deadline = monotonicNs() + RpcStats::instance().getTimeout();
+    if (RpcProxy::wait(smart_stiffness, deadline) != qi::FutureState_FinishedWithValue)
+      ROS_WARN("Motion: Failed to set smart stiffness!\n\tTrace: %s",
+               smart_stiffness.hasError(0) ? smart_stiffness.error().c_str() : "timeout");
+    if (RpcProxy::wait(push_recovery, deadline) != qi::FutureState_FinishedWithValue)
+      ROS_WARN("Motion: Failed to set Push Recovery Enabled!\n\tTrace: %s",
+               push_recovery.hasError(0) ? push_recovery.error().c_str() : "timeout");
   }
   catch (const std::exception& e)
   {
-    ROS_WARN("Motion: Failed to set external collision protection!\n\tTrace: %s", e.what());
+    ROS_WARN("Motion: Failed to manage concurrence!\n\tTrace: %s", e.what());
   }
+}
+
+void Motion::moveTo(const float& vel_x, const float& vel_y, const float& vel_th)
+{
+  ROS_INFO_STREAM("going to move x: " << vel_x << " y: " << vel_y << " th: " << vel_th);
 
-  //set PushRecoveryEnabled
   try
   {
-    motion_proxy_.call<void>("setPushRecoveryEnabled", 0);
+    static RpcStats::Method *const move_to_rpc = RpcStats::instance().get("moveTo");
+    motion_proxy_.call<void>(move_to_rpc, vel_x, vel_y, vel_th);
   }
   catch (const std::exception& e)
   {
-    ROS_WARN("Motion: Failed to set Push Recovery Enabled!\n\tTrace: %s", e.what());
+    ROS_WARN("Motion: Failed to execute MoveTo!\n\tTrace: %s", e.what());
   }
 }
 
-void Motion::moveTo(const float& vel_x, const float& vel_y, const float& vel_th)
+void Motion::requestOdometry()
 {
-  ROS_INFO_STREAM("going to move x: " << vel_x << " y: " << vel_y << " th: " << vel_th);
+  // keep the pending requests
+  if (position_future_.isValid() && position_future_.isRunning())
+    return;
 
   try
   {
-    motion_proxy_.call<void>("moveTo", vel_x, vel_y, vel_th);
+    static RpcStats::Method *const get_robot_position_rpc = RpcStats::instance().get("getRobotPosition");
+    position_future_ = motion_proxy_.async< std::vector<float> >(get_robot_position_rpc, true);
+    static RpcStats::Method *const get_robot_velocity_rpc = RpcStats::instance().get("getRobotVelocity");
+    velocity_future_ = motion_proxy_.async< std::vector<float> >(get_robot_velocity_rpc);
   }
   catch (const std::exception& e)
   {
-    ROS_WARN("Motion: Failed to execute MoveTo!\n\tTrace: %s", e.what());
+    ROS_WARN("Motion: Failed to request the odometry!\n\tTrace: %s", e.what());
   }
 }
 
+bool Motion::getOdometry(std::vector <float> *position, std::vector <float> *velocity)
+{
+  if (!position_future_.isValid() || !velocity_future_.isValid()
+      || !position_future_.isFinished() || !velocity_future_.isFinished())
+    return false;
+
+  if (position_future_.hasError() || velocity_future_.hasError())
+  {
+    ROS_WARN("Motion: Failed to get the odometry!");
+    position_future_ = qi::Future< std::vector<float> >();
+    return false;
+  }
+
+  *position = position_future_.value();
+  *velocity = velocity_future_.value();
+  position_future_ = qi::Future< std::vector<float> >();
+  return (position->size() == 3) && (velocity->size() == 3);
+}
+
 std::vector<double> Motion::getAngles(const std::string &robot_part)
 {
   std::vector<double> res;
 
   try
   {
-    res = motion_proxy_.call< std::vector<double> >("getAngles", robot_part, 1);
+    static RpcStats::Method *const get_angles_rpc = RpcStats::instance().get("getAngles");
+    res = motion_proxy_.call< std::vector<double> >(get_angles_rpc, robot_part, 1);
   }
   catch (const std::exception& e)
   {
@@ -201,7 +263,8 @@ void Motion::writeJoints(const std::vector <double> &joint_commands)
 {
   try
   {
-    motion_proxy_.async<void>("setAngles", joints_names_, joint_commands, 0.2f);
+    static RpcStats::Method *const set_angles_rpc = RpcStats::instance().get("setAngles");
+    motion_proxy_.async<void>(set_angles_rpc, joints_names_, joint_commands, 0.2f);
   }
   catch(const std::exception& e)
   {
@@ -226,7 +289,8 @@ bool Motion::stiffnessInterpolation(const std::string &motor_group,
 {
   try
   {
-    motion_proxy_.call<void>("stiffnessInterpolation", motor_group, stiffness, time);
+    static RpcStats::Method *const stiffness_interpolation_rpc = RpcStats::instance().get("stiffnessInterpolation");
+    motion_proxy_.call<void>(stiffness_interpolation_rpc, motor_group, stiffness, time);
   }
   catch (const std::exception &e)
   {
@@ -237,6 +301,23 @@ bool Motion::stiffnessInterpolation(const std::string &motor_group,
   return true;
 }
 
+bool Motion::setStiffnesses(const std::vector<std::string> &joints,
+                            const std::vector<float> &stiffnesses)
+{
+  try
+  {
+    static RpcStats::Method *const set_stiffnesses_rpc = RpcStats::instance().get("setStiffnesses");
+    motion_proxy_.call<void>(set_stiffnesses_rpc, joints, stiffnesses);
+  }
+  catch (const std::exception &e)
+  {
+    ROS_ERROR("Motion: Failed to set stiffnesses \n\tTrace: %s", e.what());
+    return false;
+  }
+
+  return true;
+}
+
 bool Motion::setStiffnessArms(const float &stiffness, const float &time)
 {
   if (!stiffnessInterpolation("LArm", stiffness, time))
@@ -15,6 +15,13 @@
  *
 */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#include <boost/bind.hpp>
+
 #include <sensor_msgs/JointState.h>
 
 #include <diagnostic_msgs/DiagnosticArray.h>
@@ -22,18 +29,71 @@
 #include <XmlRpcValue.h>
 
 #include "naoqi_dcm_driver/robot.hpp"
+#include "naoqi_dcm_driver/flight_recorder.hpp"
+#include "naoqi_dcm_driver/probes.hpp"
+#include "naoqi_dcm_driver/rpc_proxy.hpp"
 #include "naoqi_dcm_driver/tools.hpp"
+#include "naoqi_dcm_driver/tracer.hpp"
 
 QI_REGISTER_OBJECT( Robot,
                     isConnected,
                     connect,
-                    stopService);
+                    stopService,
+                    getStats,
+                    dumpTrace);
+
+namespace
+{
+//! @brief wait for a future issued during the startup until the calls deadline and report its failure
+template <typename T>
+bool joinFuture(qi::Future<T> future, const std::string &what)
+{
+  const qi::FutureState state = RpcProxy::wait(future, monotonicNs() + RpcStats::instance().getTimeout());
+  if (state == qi::FutureState_FinishedWithValue)
+    return true;
+  ROS_WARN("%s failed!\n\tTrace: %s", what.c_str(),
+           (state == qi::FutureState_Running) ? "timeout"
+           : future.hasError(0) ? future.error().c_str() : "canceled");
+  return false;
+}
 
-Robot::Robot(qi::SessionPtr session):
+//! @brief check if AutonomousLife reports being disabled
+bool lifeIsDisabled(qi::AnyObject life_proxy)
+{
+  try
+  {
+    return life_proxy.call<std::string>("getState") == "disabled";
+  }
+  catch (const std::exception&)
+  {
+    return false;
+  }
+}
+}
+
+Robot::Robot(qi::SessionPtr session,
+             const ros::NodeHandle &nh,
+             const ros::NodeHandle &pnh,
+             const bool &shutdown_ros):
                _session(session),
                session_name_("naoqi_dcm_driver"),
                is_connected_(false),
-               nhPtr_(new ros::NodeHandle("")),
+               loop_stopping_(false),
+               nhPtr_(new ros::NodeHandle(nh)),
+               pnh_(pnh),
+               shutdown_ros_(shutdown_ros),
+               clamps_(new diagnostic_msgs::DiagnosticArray()),
+               stiffness_(new sensor_msgs::JointState()),
+               stiffness_changed_(false),
+               stiffness_heartbeat_(1.0),
+               rpc_stats_(new diagnostic_msgs::DiagnosticArray()),
+               rpc_stats_period_(5.0),
+               rpc_timeout_(2.0),
+               loop_stats_msg_(new std_msgs::Float32MultiArray()),
+               loop_stats_period_(5.0),
+               derating_stiffness_(0.3),
+               derating_rate_(0.2),
+               joint_states_topic_(new sensor_msgs::JointState()),
                body_type_(""),
                topic_queue_(10),
                prefix_("naoqi_dcm"),
@@ -41,9 +101,46 @@ Robot::Robot(qi::SessionPtr session):
                controller_freq_(15.0),
                joint_precision_(0.1),
                odom_frame_("odom"),
+               odom_(new nav_msgs::Odometry()),
+               odom_decimation_(0),
+               odom_count_(0),
                use_dcm_(false),
-               stiffness_value_(0.9f)
+               use_supervisor_(true),
+               joint_states_group_(-1),
+               joint_states_decimation_(1),
+               joint_states_currents_(0),
+               stiffness_value_(0.9f),
+               disconnected_link_(qi::SignalBase::invalidSignalLink),
+               session_lost_(false),
+               reconnecting_(false),
+               reconnect_period_(0.2),
+               reset_controllers_(false),
+               active_joints_changed_(false),
+               trace_enabled_(false),
+               trace_capacity_(65536),
+               flight_recorder_duration_(10.0),
+               flight_recorder_rpcs_(4096),
+               commands_sent_(false)
 {
+  //keep the topology cache next to the ROS logs by default
+  const char *ros_home = std::getenv("ROS_HOME");
+  const char *home = std::getenv("HOME");
+  if (ros_home)
+    topology_cache_path_ = std::string(ros_home) + "/naoqi_dcm_driver_topology.bin";
+  else if (home)
+    topology_cache_path_ = std::string(home) + "/.ros/naoqi_dcm_driver_topology.bin";
+
+  //and the trace as well
+  if (ros_home)
+    trace_path_ = std::string(ros_home) + "/naoqi_dcm_driver_trace.json";
+  else if (home)
+    trace_path_ = std::string(home) + "/.ros/naoqi_dcm_driver_trace.json";
+
+  //and the flight recorder dumps
+  if (ros_home)
+    flight_recorder_directory_ = ros_home;
+  else if (home)
+    flight_recorder_directory_ = std::string(home) + "/.ros";
 }
 
 Robot::~Robot()
@@ -54,7 +151,24 @@ Robot::~Robot()
 void Robot::stopService() {
   ROS_INFO_STREAM(session_name_ << " stopping the service...");
 
-  if (motion_)
+  // the trace of the last run is kept for offline profiling
+  if (is_connected_ && trace_enabled_)
+    dumpTrace("");
+
+  // and its last seconds for post-mortems
+  if (is_connected_)
+    dumpFlightRecorder(stop_reason_.empty() ? "stopService" : stop_reason_);
+  stop_reason_.clear();
+
+  // stop watching the session before it is closed
+  if (is_connected_)
+    _session->disconnected.disconnect(disconnected_link_);
+  reconnect_thread_.interrupt();
+  if (reconnect_thread_.joinable()
+      && (reconnect_thread_.get_id() != boost::this_thread::get_id()))
+    reconnect_thread_.join();
+
+  if (motion_ && _session->isConnected())
   {
     /* reset stiffness for arms if using DCM
      * to prevent its concurrence with ALMotion */
@@ -76,7 +190,8 @@ void Robot::stopService() {
   if(nhPtr_)
   {
     nhPtr_->shutdown();
-    ros::shutdown();
+    if (shutdown_ros_)
+      ros::shutdown();
   }
 }
 
@@ -89,11 +204,13 @@ bool Robot::initializeControllers(const std::vector <std::string> &joints)
   hw_velocities_.reserve(joints_nbr);
   hw_efforts_.reserve(joints_nbr);
   hw_commands_.reserve(joints_nbr);
+  hw_vel_commands_.reserve(joints_nbr);
 
   hw_angles_.resize(joints_nbr);
   hw_velocities_.resize(joints_nbr);
   hw_efforts_.resize(joints_nbr);
   hw_commands_.resize(joints_nbr);
+  hw_vel_commands_.resize(joints_nbr, 0.0);
 
   try
   {
@@ -108,6 +225,16 @@ bool Robot::initializeControllers(const std::vector <std::string> &joints)
       hardware_interface::JointHandle pos_handle(jnt_state_interface_.getHandle(joints.at(i)),
                                                  &hw_commands_[i]);
       jnt_pos_interface_.registerHandle(pos_handle);
+
+      hardware_interface::JointHandle vel_handle(jnt_state_interface_.getHandle(joints.at(i)),
+                                                 &hw_vel_commands_[i]);
+      jnt_vel_interface_.registerHandle(vel_handle);
+
+      hardware_interface::PosVelJointHandle posvel_handle(jnt_state_interface_.getHandle(joints.at(i)),
+                                                          &hw_commands_[i],
+                                                          &hw_vel_commands_[i]);
+      jnt_posvel_interface_.registerHandle(posvel_handle);
+
       hw_efforts_[i] = stiffness_value_;
       hardware_interface::JointHandle eff_handle(jnt_state_interface_.getHandle(joints.at(i)),
                                                  &hw_efforts_[i]);
@@ -116,6 +243,8 @@ bool Robot::initializeControllers(const std::vector <std::string> &joints)
 
     registerInterface(&jnt_state_interface_);
     registerInterface(&jnt_pos_interface_);
+    registerInterface(&jnt_vel_interface_);
+    registerInterface(&jnt_posvel_interface_);
     registerInterface(&jnt_eff_interface_);
   }
   catch(const ros::Exception& e)
@@ -128,27 +257,161 @@ bool Robot::initializeControllers(const std::vector <std::string> &joints)
 }
 
 // The entry point from outside
+std::map <std::string, qi::AnyObject> Robot::resolveServices(const std::vector <std::string> &names)
+{
+  std::vector <qi::Future <qi::AnyObject> > futures;
+  futures.reserve(names.size());
+  for (std::vector <std::string>::const_iterator it = names.begin(); it != names.end(); ++it)
+  {
+    try
+    {
+      futures.push_back(_session->service(*it));
+    }
+    catch (const std::exception& e)
+    {
+      futures.push_back(qi::makeFutureError<qi::AnyObject>(e.what()));
+    }
+  }
+
+  std::map <std::string, qi::AnyObject> services;
+  const boost::uint64_t deadline = monotonicNs() + RpcStats::instance().getTimeout();
+  for (size_t i = 0; i < futures.size(); ++i)
+  {
+    if (RpcProxy::wait(futures[i], deadline) == qi::FutureState_FinishedWithValue)
+      services[names[i]] = futures[i].value();
+    else
+      ROS_DEBUG("Service %s is not available: %s", names[i].c_str(),
+                futures[i].hasError(0) ? futures[i].error().c_str() : "canceled");
+  }
+  return services;
+}
+
+std::vector <std::string> Robot::getRequiredServices()
+{
+  std::vector <std::string> names;
+  names.push_back("ALMemory");
+  names.push_back("ALMotion");
+  if (use_dcm_)
+    names.push_back("DCM");
+  return names;
+}
+
 bool Robot::connect()
 {
   is_connected_ = false;
+  loop_stopping_ = false;
+  const ros::WallTime t_start = ros::WallTime::now();
 
   // Load ROS Parameters
   if (!loadParams())
     return false;
 
-  // Initialize DCM Wrapper
-  if (use_dcm_)
-    dcm_ = boost::shared_ptr<DCM>(new DCM(_session, controller_freq_));
+  // Resolve all services at once
+  std::vector <std::string> names = getRequiredServices();
+  names.push_back("ALBodyTemperature");
+  names.push_back("ALTouch");
+  names.push_back("ALAutonomousLife");
+  std::map <std::string, qi::AnyObject> services = resolveServices(names);
+  const ros::WallTime t_services = ros::WallTime::now();
 
-  // Initialize Memory Wrapper
-  memory_ = boost::shared_ptr<Memory>(new Memory(_session));
+  if (!services.count("ALMemory") || !services.count("ALMotion")
+      || (use_dcm_ && !services.count("DCM")))
+  {
+    ROS_ERROR("Failed to connect to the Memory, Motion or DCM proxies!");
+    return false;
+  }
 
-  //get the robot's name
-  std::string robot = memory_->getData("RobotConfig/Body/Type");
+  // Initialize DCM, Memory and Motion Wrappers
+  if (use_dcm_)
+    dcm_ = boost::shared_ptr<DCM>(new DCM(services["DCM"], controller_freq_));
+  memory_ = boost::shared_ptr<Memory>(new Memory(services["ALMemory"]));
+  motion_ = boost::shared_ptr<Motion>(new Motion(services["ALMotion"]));
+
+  // Issue the independent configuration calls and queries together
+  std::vector <qi::Future <void> > configuration = motion_->configure();
+
+  // stop ALTouch service to prevent the robot shaking
+  qi::Future <void> touch_exit;
+  if (services.count("ALTouch"))
+    touch_exit = services["ALTouch"].async<void>("exit");
+
+  qi::Future <std::string> life_state;
+  if (services.count("ALAutonomousLife"))
+    life_state = services["ALAutonomousLife"].async<std::string>("getState");
+
+  qi::Future <std::string> body_type = memory_->getDataAsync("RobotConfig/Body/Type");
+  qi::Future <std::string> naoqi_version = services["ALMemory"].async<std::string>("version");
+
+  //get the robot's name and NAOqi version, they validate the topology cache
+  std::string body, version;
+  if (joinFuture(body_type, "Reading the robot's body type"))
+    body = body_type.value();
+  if (joinFuture(naoqi_version, "Reading NAOqi version"))
+    version = naoqi_version.value();
+  std::string robot = body;
   std::transform(robot.begin(), robot.end(), robot.begin(), ::tolower);
 
-  // Initialize Motion Wrapper
-  motion_ = boost::shared_ptr<Motion>(new Motion(_session));
+  //read the body names from the cache, or request the missing ones
+  std::vector <std::string> parts(motor_groups_);
+  parts.push_back("Body");
+  parts.push_back("JointActuators");
+  std::vector <std::vector <std::string> > parts_names(parts.size());
+  std::vector <qi::Future <std::vector <std::string> > > parts_futures(parts.size());
+  topology_cache_ = boost::shared_ptr<TopologyCache>(new TopologyCache(topology_cache_path_));
+  const bool cached = !body.empty() && !version.empty() && topology_cache_->load(body, version);
+  for (size_t i = 0; i < parts.size(); ++i)
+    if (!cached || !topology_cache_->getBodyNames(parts[i], &parts_names[i]))
+      parts_futures[i] = motion_->getBodyNamesAsync(parts[i]);
+
+  //allow the temperature reporting (for CPU)
+  qi::Future <void> body_temperature;
+  if (services.count("ALBodyTemperature")
+      && ((robot == "pepper") || (robot == "juliette") || (robot == "nao")))
+    body_temperature = services["ALBodyTemperature"].async<void>("setEnableNotifications", true);
+
+  for (size_t i = 0; i < configuration.size(); ++i)
+    joinFuture(configuration[i], "Motion configuration");
+  if (touch_exit.isValid() && joinFuture(touch_exit, "Stopping ALTouch"))
+    ROS_INFO_STREAM("Naoqi Touch service is shut down");
+  if (body_temperature.isValid())
+    joinFuture(body_temperature, "Enabling ALBodyTemperature notifications");
+
+  // stop AutonomousLife service to prevent the robot shaking
+  if (life_state.isValid() && joinFuture(life_state, "Reading AutonomousLife state")
+      && (life_state.value() != "disabled"))
+  {
+    try
+    {
+      ROS_INFO_STREAM("Shutting down Naoqi AutonomousLife ...");
+      services["ALAutonomousLife"].call<void>("setState", "disabled");
+      if (!waitFor(boost::bind(&lifeIsDisabled, services["ALAutonomousLife"]), 2.0))
+        ROS_WARN("AutonomousLife did not report being disabled in time");
+    }
+    catch (const std::exception& e)
+    {
+      ROS_WARN("Did not stop AutonomousLife!\n\tTrace: %s", e.what());
+    }
+  }
+
+  bool discovered(false), complete(true);
+  for (size_t i = 0; i < parts.size(); ++i)
+  {
+    if (!parts_futures[i].isValid())
+      continue;
+    discovered = true;
+    if (joinFuture(parts_futures[i], "Reading the body names of " + parts[i]))
+    {
+      parts_names[i] = parts_futures[i].value();
+      topology_cache_->setBodyNames(parts[i], parts_names[i]);
+    }
+    else
+      complete = false;
+  }
+  if (!discovered)
+    ROS_INFO_STREAM("Robot topology read from the cache " << topology_cache_path_);
+  else if (complete && !body.empty() && !version.empty())
+    topology_cache_->save();
+  const ros::WallTime t_configuration = ros::WallTime::now();
 
   // check if the robot is waked up
   if (motor_groups_.size() == 1)
@@ -167,9 +430,12 @@ bool Robot::connect()
 
   if (use_dcm_)
     motion_->manageConcurrence();
+  const ros::WallTime t_wakeup = ros::WallTime::now();
 
   //read Naoqi joints names that will be controlled
-  qi_joints_ = motion_->getBodyNamesFromGroup(motor_groups_);
+  qi_joints_.clear();
+  for (size_t i = 0; i < motor_groups_.size(); ++i)
+    qi_joints_.insert(qi_joints_.end(), parts_names[i].begin(), parts_names[i].end());
   if (qi_joints_.empty())
     ROS_ERROR("Controlled joints are not known.");
   //define HW joints if empty
@@ -181,10 +447,17 @@ bool Robot::connect()
   }
   ROS_INFO_STREAM("HW controlled joints are : " << print(hw_joints_));
 
+  // the control loop is not running, the recorded ticks can follow the new joints
+  if (flight_recorder_duration_ > 0.0)
+    FlightRecorder::instance().enable(static_cast<size_t>(std::ceil(flight_recorder_duration_*controller_freq_)),
+                                      hw_joints_, std::max(flight_recorder_rpcs_, 1));
+
   ignoreMimicJoints(&qi_joints_);
   ROS_INFO_STREAM("Naoqi controlled joints are : " << print(qi_joints_));
   qi_commands_.reserve(qi_joints_.size());
   qi_commands_.resize(qi_joints_.size(), 0.0);
+  qi_vel_commands_.reserve(qi_joints_.size());
+  qi_vel_commands_.resize(qi_joints_.size(), 0.0);
 
   //initialise Memory, Motion, and DCM classes with controlled joints
   memory_->init(qi_joints_);
@@ -195,14 +468,33 @@ bool Robot::connect()
   hw_enabled_ = checkJoints();
 
   //read joints names to initialize the joint_states topic
-  joint_states_topic_.header.frame_id = "base_link";
-  joint_states_topic_.name = motion_->getBodyNames("Body"); //Body=JointActuators+Wheels
-  joint_states_topic_.position.resize(joint_states_topic_.name.size());
+  joint_states_topic_->header.frame_id = "base_link";
+  joint_states_topic_->name = parts_names[motor_groups_.size()]; //Body=JointActuators+Wheels
+  joint_states_topic_->position.resize(joint_states_topic_->name.size(), 0.0);
+  joint_states_topic_->velocity.resize(joint_states_topic_->name.size(), 0.0);
+  joint_states_topic_->effort.resize(joint_states_topic_->name.size(), 0.0);
+  joint_states_group_ = memory_->addKeysGroup(std::vector<std::string>(), joint_states_decimation_);
+
+  //add the sensors to the keys read at each loop
+  sensors_ = boost::shared_ptr<Sensors>(new Sensors(memory_, nhPtr_.get(), pnh_, prefix_, topic_queue_, robot));
+  sensors_->init();
 
   //read joints names to initialize the diagnostics
-  std::vector<std::string> joints_all_names = motion_->getBodyNames("JointActuators");
+  const std::vector<std::string> &joints_all_names = parts_names[motor_groups_.size()+1];
   diagnostics_ = boost::shared_ptr<Diagnostics>(
-        new Diagnostics(_session, &diag_pub_, joints_all_names, robot));
+        new Diagnostics(services["ALMemory"], &diag_pub_, &joint_stats_pub_, joints_all_names));
+  diagnostics_->loadParams(pnh_);
+
+  //map the HW joints to the diagnostics joints for the derating
+  hw_diagnostics_index_.assign(hw_joints_.size(), -1);
+  hw_derating_.assign(hw_joints_.size(), 1.0);
+  for (size_t i = 0; i < hw_joints_.size(); ++i)
+  {
+    std::vector<std::string>::const_iterator it =
+        std::find(joints_all_names.begin(), joints_all_names.end(), hw_joints_[i]);
+    if (it != joints_all_names.end())
+      hw_diagnostics_index_[i] = static_cast<int>(it - joints_all_names.begin());
+  }
 
   is_connected_ = true;
 
@@ -227,6 +519,30 @@ bool Robot::connect()
   if(!initializeControllers(hw_joints_))
     return false;
 
+  // Load the joints limits to supervise the commands
+  if (use_supervisor_)
+  {
+    supervisor_ = boost::shared_ptr<Supervisor>(new Supervisor(controller_freq_));
+    supervisor_->init(hw_joints_, pnh_);
+  }
+
+  // Nothing is read or written until controllers claim joints
+  updateActiveJoints();
+
+  // Watch the session to reconnect it if it drops
+  session_url_ = _session->url().str();
+  disconnected_link_ = _session->disconnected.connect(
+        boost::bind(&Robot::onDisconnected, this, _1));
+
+  const ros::WallTime t_end = ros::WallTime::now();
+  ROS_INFO("Startup took %.3f s: services %.3f s, configuration %.3f s, "
+           "wake up %.3f s, initialization %.3f s",
+           (t_end - t_start).toSec(),
+           (t_services - t_start).toSec(),
+           (t_configuration - t_services).toSec(),
+           (t_wakeup - t_configuration).toSec(),
+           (t_end - t_wakeup).toSec());
+
   ROS_INFO_STREAM(session_name_ << " module initialized!");
   return true;
 }
@@ -237,16 +553,26 @@ void Robot::subscribe()
   cmd_moveto_sub_ = nhPtr_->subscribe(prefix_+"cmd_moveto", 1, &Robot::commandVelocity, this);
 
   diag_pub_ = nhPtr_->advertise<diagnostic_msgs::DiagnosticArray>(prefix_+"diagnostics", topic_queue_);
+  joint_stats_pub_ = nhPtr_->advertise<std_msgs::Float32MultiArray>(prefix_+"joint_stats", topic_queue_);
 
-  stiffness_pub_ = nhPtr_->advertise<std_msgs::Float32>(prefix_+"stiffnesses", topic_queue_);
-  stiffness_.data = 1.0f;
+  stiffness_pub_ = nhPtr_->advertise<sensor_msgs::JointState>(prefix_+"stiffnesses", topic_queue_, true);
+  rpc_stats_pub_ = nhPtr_->advertise<diagnostic_msgs::DiagnosticArray>(prefix_+"rpc_stats", topic_queue_);
+  loop_stats_pub_ = nhPtr_->advertise<std_msgs::Float32MultiArray>(prefix_+"loop_stats", topic_queue_);
+  stiffness_->name = qi_joints_;
+  stiffness_->effort.resize(qi_joints_.size(), 0.0);
+  qi_stiffness_joints_.reserve(qi_joints_.size());
+  qi_stiffness_commands_.reserve(qi_joints_.size());
 
   joint_states_pub_ = nhPtr_->advertise<sensor_msgs::JointState>("/joint_states", topic_queue_);
+
+  initOdometry();
+
+  clamps_pub_ = nhPtr_->advertise<diagnostic_msgs::DiagnosticArray>(prefix_+"command_clamps", topic_queue_);
 }
 
 bool Robot::loadParams()
 {
-  ros::NodeHandle nh("~");
+  ros::NodeHandle &nh = pnh_;
   // Load Server Parameters
   nh.getParam("BodyType", body_type_);
   nh.getParam("TopicQueue", topic_queue_);
@@ -254,10 +580,35 @@ bool Robot::loadParams()
   nh.getParam("ControllerFrequency", controller_freq_);
   nh.getParam("JointPrecision", joint_precision_);
   nh.getParam("OdomFrame", odom_frame_);
+  nh.getParam("odom_decimation", odom_decimation_);
   nh.getParam("use_dcm", use_dcm_);
+  nh.getParam("command_supervisor", use_supervisor_);
+  nh.getParam("joint_states_decimation", joint_states_decimation_);
+  nh.getParam("topology_cache", topology_cache_path_);
+  nh.getParam("reconnect_period", reconnect_period_);
+  nh.getParam("trace/enabled", trace_enabled_);
+  nh.getParam("trace/capacity", trace_capacity_);
+  nh.getParam("trace/path", trace_path_);
+  nh.getParam("flight_recorder/duration", flight_recorder_duration_);
+  nh.getParam("flight_recorder/rpcs", flight_recorder_rpcs_);
+  nh.getParam("flight_recorder/directory", flight_recorder_directory_);
+  if (trace_enabled_)
+    Tracer::instance().enable(std::max(trace_capacity_, 1));
 
   if (nh.hasParam("max_stiffness"))
     nh.getParam("max_stiffness", stiffness_value_);
+  nh.getParam("stiffness_heartbeat", stiffness_heartbeat_);
+  nh.getParam("rpc_stats_period", rpc_stats_period_);
+  nh.getParam("rpc_timeout", rpc_timeout_);
+  if (rpc_timeout_ <= 0.0)
+  {
+    ROS_WARN("Ignoring the invalid rpc_timeout %.3f s, using 2 s", rpc_timeout_);
+    rpc_timeout_ = 2.0;
+  }
+  RpcStats::instance().setTimeout(rpc_timeout_);
+  nh.getParam("loop_stats_period", loop_stats_period_);
+  nh.getParam("derating/stiffness", derating_stiffness_);
+  nh.getParam("derating/rate", derating_rate_);
 
   if (use_dcm_)
     ROS_WARN_STREAM("Please, be carefull! "
@@ -315,47 +666,228 @@ void Robot::run()
   controllerLoop();
 }
 
+void Robot::stopLoop()
+{
+  loop_stopping_ = true;
+}
+
 void Robot::controllerLoop()
 {
-  static ros::Rate rate(controller_freq_);
-  while(ros::ok())
+  ros::Rate rate(controller_freq_);
+  loop_stats_.reset(new LoopStats(1.0/controller_freq_));
+  Tracer::instance().setThreadName("control_loop");
+  while(ros::ok() && !loop_stopping_)
   {
     ros::Time time = ros::Time::now();
+    loop_stats_->startTick();
 
     if(!is_connected_)
       break;
 
-    //publishBaseFootprint(time);
+    // nothing is read or written until the session is back
+    if (!resume())
+    {
+      loop_stats_->cancelTick();
+      rate.sleep();
+      continue;
+    }
+
+    // the controllers switched during the last update, before anything is read
+    if (active_joints_changed_)
+      updateActiveJoints();
 
-    stiffness_pub_.publish(stiffness_);
+    publishOdometry(time);
+    loop_stats_->mark(LoopStats::ODOMETRY);
 
+    // a failure due to a lost session only freezes the loop
     if (!diagnostics_->publish())
-      stopService();
+    {
+      if (_session->isConnected())
+      {
+        stop_reason_ = "the diagnostics failed";
+        stopService();
+      }
+      else
+        onDisconnected("the diagnostics failed");
+    }
+    loop_stats_->mark(LoopStats::DIAGNOSTICS);
 
     readJoints();
+    loop_stats_->mark(LoopStats::READ);
 
-    //motion_->stiffnessInterpolation(diagnostics_->getForcedJoints(), 0.3f, 2.0f);
-  
     try
     {
-      manager_->update(time, ros::Duration(1.0f/controller_freq_));
+      manager_->update(time, ros::Duration(1.0f/controller_freq_), reset_controllers_);
+      reset_controllers_ = false;
     }
     catch(ros::Exception& e)
     {
       ROS_ERROR("%s", e.what());
+      loop_stats_->mark(LoopStats::UPDATE);
+      recordTick();
+      dumpFlightRecorder(std::string("the controllers update failed: ") + e.what());
       return;
     }
+    loop_stats_->mark(LoopStats::UPDATE);
 
     writeJoints();
+    loop_stats_->mark(LoopStats::WRITE);
+
+    publishStiffness(time);
+    loop_stats_->mark(LoopStats::STIFFNESS);
+
+    publishRpcStats(time);
+    publishLoopStats(time);
+    loop_stats_->mark(LoopStats::STATISTICS);
 
     //no need if Naoqi Driver is running
-    publishJointStateFromAlMotion();
-    
+    publishJointStates(time);
+    loop_stats_->mark(LoopStats::JOINT_STATES);
+
+    sensors_->publish(time);
+    loop_stats_->mark(LoopStats::SENSORS);
+
+    recordTick();
+
     rate.sleep();
   }
   ROS_INFO_STREAM("Shutting down the main loop");
 }
 
+bool Robot::registerService()
+{
+  try
+  {
+    _session->registerService(session_name_, shared_from_this()).value();
+  }
+  catch (const std::exception& e)
+  {
+    ROS_ERROR("Could not register the service %s!\n\tTrace: %s", session_name_.c_str(), e.what());
+    return false;
+  }
+  return true;
+}
+
+void Robot::onDisconnected(const std::string &reason)
+{
+  if (!is_connected_)
+    return;
+
+  boost::mutex::scoped_lock lock(reconnect_mutex_);
+  reconnect_services_.clear();
+  if (session_lost_ && reconnecting_)
+    return;
+
+  if (!session_lost_)
+  {
+    ROS_WARN("The session is lost (%s), freezing the commands until it is back", reason.c_str());
+    session_lost_ = true;
+    session_lost_time_ = ros::WallTime::now();
+    // writing the file is left to the loop, out of the signal thread
+    pending_dump_ = "the session is lost: " + reason;
+  }
+
+  // the previous reconnect thread, if any, has already returned
+  if (reconnect_thread_.joinable())
+    reconnect_thread_.join();
+  reconnecting_ = true;
+  reconnect_thread_ = boost::thread(&Robot::reconnect, this);
+}
+
+void Robot::reconnect()
+{
+  const std::vector <std::string> names = getRequiredServices();
+  try
+  {
+    while (true)
+    {
+      if (!_session->isConnected())
+      {
+        // a qi wait is not an interruption point, bound it so that stopService can join this thread
+        qi::Future <void> connection = _session->connect(session_url_);
+        const qi::FutureState state = RpcProxy::wait(connection, monotonicNs() + RpcStats::instance().getTimeout());
+        if (state != qi::FutureState_FinishedWithValue)
+          ROS_DEBUG("Could not reconnect to %s: %s", session_url_.c_str(),
+                    connection.hasError(0) ? connection.error().c_str()
+                                           : (state == qi::FutureState_Running ? "timeout" : "canceled"));
+      }
+
+      if (_session->isConnected())
+      {
+        std::map <std::string, qi::AnyObject> services = resolveServices(names);
+        if (services.size() == names.size())
+        {
+          boost::mutex::scoped_lock lock(reconnect_mutex_);
+          reconnect_services_.swap(services);
+          reconnecting_ = false;
+          return;
+        }
+      }
+
+      boost::this_thread::sleep(boost::posix_time::microseconds(
+                                  static_cast<long>(reconnect_period_*1e6)));
+    }
+  }
+  catch (const boost::thread_interrupted&)
+  {
+  }
+
+  boost::mutex::scoped_lock lock(reconnect_mutex_);
+  reconnecting_ = false;
+}
+
+bool Robot::resume()
+{
+  std::map <std::string, qi::AnyObject> services;
+  std::string dump_reason;
+  bool lost;
+  {
+    boost::mutex::scoped_lock lock(reconnect_mutex_);
+    dump_reason.swap(pending_dump_);
+    lost = session_lost_;
+    if (lost && !reconnect_services_.empty())
+    {
+      services.swap(reconnect_services_);
+      session_lost_ = false;
+    }
+  }
+  if (!dump_reason.empty())
+    dumpFlightRecorder(dump_reason);
+  if (!lost)
+    return true;
+  if (services.empty())
+    return false;
+
+  // the joints names are kept, only the proxies and the DCM aliases are rebuilt
+  memory_->setProxy(services["ALMemory"]);
+  motion_->setProxy(services["ALMotion"]);
+  diagnostics_->setProxy(services["ALMemory"]);
+  std::vector <qi::Future <void> > configuration = motion_->configure();
+  if (use_dcm_)
+  {
+    dcm_->setProxy(services["DCM"]);
+    dcm_->init(qi_joints_);
+    if (!qi_write_joints_.empty())
+      dcm_->setJoints(qi_write_joints_);
+    motion_->manageConcurrence();
+  }
+  for (size_t i = 0; i < configuration.size(); ++i)
+    joinFuture(configuration[i], "Motion configuration");
+  registerService();
+
+  // the applied stiffness is unknown, send all of it again
+  stiffness_ = boost::make_shared<sensor_msgs::JointState>(*stiffness_);
+  std::fill(stiffness_->effort.begin(), stiffness_->effort.end(), -1.0);
+
+  // restart the controllers from the current joints angles
+  readJoints();
+  reset_controllers_ = true;
+
+  ROS_INFO("The session is back after %.3f s, resuming the loop",
+           (ros::WallTime::now() - session_lost_time_).toSec());
+  return true;
+}
+
 bool Robot::isConnected()
 {
   return is_connected_;
@@ -363,6 +895,8 @@ bool Robot::isConnected()
 
 void Robot::commandVelocity(const geometry_msgs::TwistConstPtr &msg)
 {
+  TraceSpan span("ros", "commandVelocity");
+
   //reset stiffness for arms if using DCM to prevent its concurrence with ALMotion
   if(use_dcm_)
     motion_->setStiffnessArms(0.0f, 1.0f);
@@ -375,46 +909,64 @@ void Robot::commandVelocity(const geometry_msgs::TwistConstPtr &msg)
     motion_->setStiffnessArms(1.0f, 1.0f);
 }
 
-void Robot::publishBaseFootprint(const ros::Time &ts)
+void Robot::initOdometry()
 {
-  std::string odom_frame, base_link_frame;
-  try 
-  {
-    odom_frame = base_footprint_listener_.resolve(odom_frame_);
-    base_link_frame = base_footprint_listener_.resolve("base_link");
-  }
-  catch(ros::Exception& e)
-  {
-    ROS_ERROR("%s", e.what());
+  if (odom_decimation_ <= 0)
     return;
-  }
 
-  tf::StampedTransform tf_odom_to_base, tf_odom_to_left_foot, tf_odom_to_right_foot;
-  double temp_freq = 1.0f/(10.0*high_freq_);
-  if(!base_footprint_listener_.waitForTransform(odom_frame, base_link_frame, ros::Time(0), ros::Duration(temp_freq)))
-    return;
-  try 
-  {
-    base_footprint_listener_.lookupTransform(odom_frame, base_link_frame,  ros::Time(0), tf_odom_to_base);
-  }
-  catch (const tf::TransformException& ex)
-  {
-    ROS_ERROR("%s",ex.what());
-    return ;
-  }
+  // resolve the frames once
+  std::string tf_prefix, tf_prefix_key;
+  if (pnh_.searchParam("tf_prefix", tf_prefix_key))
+    pnh_.getParam(tf_prefix_key, tf_prefix);
+  std::string odom_frame = tf::resolve(tf_prefix, odom_frame_);
+  std::string base_footprint_frame = tf::resolve(tf_prefix, "base_footprint");
+
+  odom_->header.frame_id = odom_frame;
+  odom_->child_frame_id = base_footprint_frame;
+  odom_tf_.header.frame_id = odom_frame;
+  odom_tf_.child_frame_id = base_footprint_frame;
+
+  odom_position_.reserve(3);
+  odom_velocity_.reserve(3);
 
-  tf::Vector3 new_origin = (tf_odom_to_right_foot.getOrigin() + tf_odom_to_left_foot.getOrigin())/2.0;
-  double height = std::min(tf_odom_to_left_foot.getOrigin().getZ(), tf_odom_to_right_foot.getOrigin().getZ());
-  new_origin.setZ(height);
+  odom_pub_ = nhPtr_->advertise<nav_msgs::Odometry>(prefix_+"odom", topic_queue_);
 
-  double roll, pitch, yaw;
-  tf_odom_to_base.getBasis().getRPY(roll, pitch, yaw);
+  // the first request is answered by the next loop
+  motion_->requestOdometry();
+}
 
-  tf::Transform tf_odom_to_footprint(tf::createQuaternionFromYaw(yaw), new_origin);
-  tf::Transform tf_base_to_footprint = tf_odom_to_base.inverse() * tf_odom_to_footprint;
+void Robot::publishOdometry(const ros::Time &ts)
+{
+  if ((odom_decimation_ <= 0) || (++odom_count_ < odom_decimation_))
+    return;
 
-  base_footprint_broadcaster_.sendTransform(tf::StampedTransform(tf_base_to_footprint, ts,
-                                                                 base_link_frame, "base_footprint"));
+  // the position and velocity requested at a previous loop
+  if (!motion_->getOdometry(&odom_position_, &odom_velocity_))
+    return;
+  odom_count_ = 0;
+  motion_->requestOdometry();
+
+  geometry_msgs::Quaternion orientation = tf::createQuaternionMsgFromYaw(odom_position_[2]);
+
+  odom_tf_.header.stamp = ts;
+  odom_tf_.transform.translation.x = odom_position_[0];
+  odom_tf_.transform.translation.y = odom_position_[1];
+  odom_tf_.transform.translation.z = 0.0;
+  odom_tf_.transform.rotation = orientation;
+  base_footprint_broadcaster_.sendTransform(odom_tf_);
+
+  // intra-process subscribers may still hold the last message
+  if (!odom_.unique())
+    odom_ = boost::make_shared<nav_msgs::Odometry>(*odom_);
+
+  odom_->header.stamp = ts;
+  odom_->pose.pose.position.x = odom_position_[0];
+  odom_->pose.pose.position.y = odom_position_[1];
+  odom_->pose.pose.orientation = orientation;
+  odom_->twist.twist.linear.x = odom_velocity_[0];
+  odom_->twist.twist.linear.y = odom_velocity_[1];
+  odom_->twist.twist.angular.z = odom_velocity_[2];
+  odom_pub_.publish(odom_);
 }
 
 std::vector <bool> Robot::checkJoints()
@@ -441,53 +993,171 @@ std::vector <bool> Robot::checkJoints()
 
 void Robot::readJoints()
 {
-  //read memory keys for joint/position/sensor
-  std::vector<float> qi_joints_positions = memory_->getListData();
+  NAOQI_DCM_PROBE_SCOPE(read_joints);
+  //read memory keys for joint/position/sensor, and other keys due at this tick
+  if (!memory_->update())
+    return;
+
+  const float *qi_position_j = memory_->getKeysGroupData(0);
+  if (qi_position_j == NULL)
+    return;
 
   //store joints angles
   std::vector<double>::iterator hw_command_j = hw_commands_.begin();
+  std::vector<double>::iterator hw_vel_command_j = hw_vel_commands_.begin();
   std::vector<double>::iterator hw_angle_j = hw_angles_.begin();
   std::vector<double>::iterator hw_velocity_j = hw_velocities_.begin();
-  std::vector<float>::iterator qi_position_j = qi_joints_positions.begin();
-  std::vector<bool>::iterator hw_enabled_j = hw_enabled_.begin();
+  std::vector<bool>::iterator hw_read_j = hw_read_.begin();
+  std::vector<bool>::iterator hw_fresh_j = hw_fresh_.begin();
 
-  for(; hw_command_j != hw_commands_.end(); ++hw_command_j, ++hw_angle_j, ++hw_enabled_j, ++hw_velocity_j)
+  for(; hw_command_j != hw_commands_.end(); ++hw_command_j, ++hw_vel_command_j, ++hw_angle_j, ++hw_read_j, ++hw_fresh_j, ++hw_velocity_j)
   {
-    if (!*hw_enabled_j)
+    if (!*hw_read_j)
       continue;
 
-    *hw_velocity_j = (*qi_position_j - *hw_angle_j)*controller_freq_;
+    // no velocity at the first read, the previous angle is stale
+    *hw_velocity_j = *hw_fresh_j ? 0.0 : (*qi_position_j - *hw_angle_j)*controller_freq_;
+    *hw_fresh_j = false;
     *hw_angle_j = *qi_position_j;
     // Set commands to the read angles for when no command specified
     *hw_command_j = *qi_position_j;
+    *hw_vel_command_j = 0.0;
 
     //increment qi iterators
     ++qi_position_j;
   }
 }
 
-void Robot::publishJointStateFromAlMotion(){
-  joint_states_topic_.header.stamp = ros::Time::now();
-  joint_states_topic_.position = motion_->getAngles("Body");
+void Robot::publishJointStates(const ros::Time &ts)
+{
+  if ((joint_states_group_ < 0) || !memory_->isKeysGroupUpdated(joint_states_group_))
+    return;
+
+  const float *qi_positions = memory_->getKeysGroupData(0);
+  const float *qi_others = memory_->getKeysGroupData(joint_states_group_);
+
+  // intra-process subscribers may still hold the last message
+  if (!joint_states_topic_.unique())
+    joint_states_topic_ = boost::make_shared<sensor_msgs::JointState>(*joint_states_topic_);
+
+  // nothing to differentiate at the first message, and after a freeze the
+  // wheels speed is only integrated over a few periods
+  const double period = joint_states_decimation_/controller_freq_;
+  double dt = joint_states_topic_->header.stamp.isZero() ? 0.0 : (ts - joint_states_topic_->header.stamp).toSec();
+  double wheels_dt = std::min(dt, 3.0*period);
+  joint_states_topic_->header.stamp = ts;
+
+  // update the message in place
+  for (int i=0; i<joint_states_sources_.size(); ++i)
+  {
+    int source = joint_states_sources_[i];
+    float value = (source >= 0) ? qi_positions[source] : qi_others[-source-1];
+
+    if (joint_states_wheels_[i])
+    {
+      joint_states_topic_->velocity[i] = value;
+      joint_states_topic_->position[i] += value*wheels_dt;
+    }
+    else
+    {
+      joint_states_topic_->velocity[i] = (dt > 0.0) ? (value - joint_states_topic_->position[i])/dt : 0.0;
+      joint_states_topic_->position[i] = value;
+    }
+    joint_states_topic_->effort[i] = qi_others[joint_states_currents_ + i];
+  }
+
   joint_states_pub_.publish(joint_states_topic_);
 }
 
+void Robot::updateJointStatesKeys()
+{
+  int joints_nbr = joint_states_topic_->name.size();
+  joint_states_sources_.resize(joints_nbr);
+  joint_states_wheels_.resize(joints_nbr);
+
+  // joints read for control are reused, others are read at the joint states rate
+  std::vector <std::string> keys;
+  for (int i=0; i<joints_nbr; ++i)
+  {
+    const std::string &name = joint_states_topic_->name.at(i);
+
+    joint_states_wheels_[i] = (name.find("Wheel") != std::string::npos);
+
+    std::vector<std::string>::const_iterator qi_j = std::find(qi_read_joints_.begin(), qi_read_joints_.end(), name);
+    if (qi_j != qi_read_joints_.end())
+    {
+      joint_states_sources_[i] = qi_j - qi_read_joints_.begin();
+      continue;
+    }
+
+    joint_states_sources_[i] = -static_cast<int>(keys.size()) - 1;
+    if (joint_states_wheels_[i])
+      keys.push_back("Device/SubDeviceList/" + name + "/Speed/Sensor/Value");
+    else
+      keys.push_back("Device/SubDeviceList/" + name + "/Position/Sensor/Value");
+  }
+
+  // the efforts are the electric currents, read in the same batch
+  joint_states_currents_ = keys.size();
+  for (int i=0; i<joints_nbr; ++i)
+    keys.push_back("Device/SubDeviceList/" + joint_states_topic_->name.at(i) + "/ElectricCurrent/Sensor/Value");
+
+  memory_->setKeysGroup(joint_states_group_, keys);
+}
+
 void Robot::writeJoints()
 {
+  NAOQI_DCM_PROBE_SCOPE(write_joints);
+  commands_sent_ = false;
   // Check if there is some change in joints values
   bool changed(false);
-  motion_->stiffnessInterpolation(motor_groups_, (hw_efforts_[0]>1?1:hw_efforts_[0]), 0.001f);
+  writeStiffness();
+
+  // Limit the commands and report the clamped joints
+  const double lead = use_dcm_ ? dcm_->getCommandLead() : 1.0/controller_freq_;
+  if (supervisor_)
+  {
+    // on change, and every second while the same joints stay clamped
+    const int clamped = supervisor_->clamp(&hw_commands_, &hw_vel_commands_, hw_angles_, hw_claimed_, lead);
+    const ros::Time now = ros::Time::now();
+    if (supervisor_->haveClampsChanged()
+        || ((clamped > 0) && ((now - clamps_->header.stamp).toSec() >= 1.0)))
+    {
+      if (!clamps_.unique())
+        clamps_ = boost::make_shared<diagnostic_msgs::DiagnosticArray>(*clamps_);
+      clamps_->header.stamp = now;
+      supervisor_->getClampEvents(clamps_.get());
+      clamps_pub_.publish(clamps_);
+    }
+  }
+
   std::vector<double>::iterator hw_angle_j = hw_angles_.begin();
   std::vector<double>::iterator hw_command_j = hw_commands_.begin();
+  std::vector<double>::iterator hw_vel_command_j = hw_vel_commands_.begin();
   std::vector<double>::iterator qi_command_j = qi_commands_.begin();
-  std::vector<bool>::iterator hw_enabled_j = hw_enabled_.begin();
-  for(int i=0; hw_command_j != hw_commands_.end(); ++i, ++hw_command_j, ++hw_angle_j, ++hw_enabled_j)
+  std::vector<double>::iterator qi_vel_command_j = qi_vel_commands_.begin();
+  std::vector<bool>::iterator hw_claimed_j = hw_claimed_.begin();
+  for(int i=0; hw_command_j != hw_commands_.end(); ++i, ++hw_command_j, ++hw_vel_command_j, ++hw_angle_j, ++hw_claimed_j)
   {
-    if (!*hw_enabled_j)
+    if (!*hw_claimed_j)
       continue;
 
     *qi_command_j = *hw_command_j;
+    *qi_vel_command_j = *hw_vel_command_j;
+
+    // ALMotion has no velocity input, so lead the target by one period
+    if (!use_dcm_)
+      *qi_command_j += *hw_vel_command_j/controller_freq_;
+
     ++qi_command_j;
+    ++qi_vel_command_j;
+
+    // velocity commands are sent every tick, whatever their amplitude
+    if (*hw_vel_command_j != 0.0)
+    {
+      changed = true;
+      continue;
+    }
 
     double diff = std::fabs(*hw_command_j - *hw_angle_j);
     if(diff > joint_precision_)
@@ -498,13 +1168,162 @@ void Robot::writeJoints()
   }
   
   // Update joints values if there are some changes
-  if(!changed)
+  if(!changed || qi_write_joints_.empty())
     return;
 
   if (use_dcm_)
-    dcm_->writeJoints(qi_commands_);
+    dcm_->writeJoints(qi_commands_, qi_vel_commands_);
   else
     motion_->writeJoints(qi_commands_);
+  commands_sent_ = true;
+}
+
+bool Robot::prepareSwitch(const std::list<hardware_interface::ControllerInfo> &start_list,
+                          const std::list<hardware_interface::ControllerInfo> &stop_list)
+{
+  std::list<hardware_interface::ControllerInfo>::const_iterator it = start_list.begin();
+  for (; it != start_list.end(); ++it)
+  {
+    std::vector<hardware_interface::InterfaceResources>::const_iterator res = it->claimed_resources.begin();
+    for (; res != it->claimed_resources.end(); ++res)
+    {
+      std::set<std::string>::const_iterator joint = res->resources.begin();
+      for (; joint != res->resources.end(); ++joint)
+      {
+        std::vector<std::string>::const_iterator qi_j = std::find(qi_joints_.begin(), qi_joints_.end(), *joint);
+        if (qi_j == qi_joints_.end())
+          ROS_WARN_STREAM("Controller " << it->name << " claims " << *joint
+                          << " that is not controlled through Naoqi");
+      }
+    }
+  }
+  return true;
+}
+
+void Robot::doSwitch(const std::list<hardware_interface::ControllerInfo> &start_list,
+                     const std::list<hardware_interface::ControllerInfo> &stop_list)
+{
+  std::list<hardware_interface::ControllerInfo>::const_iterator it = stop_list.begin();
+  for (; it != stop_list.end(); ++it)
+  {
+    controllers_joints_.erase(it->name);
+    controllers_states_.erase(it->name);
+  }
+
+  for (it = start_list.begin(); it != start_list.end(); ++it)
+  {
+    std::vector<std::string> &joints = controllers_joints_[it->name];
+    joints.clear();
+
+    std::vector<hardware_interface::InterfaceResources>::const_iterator res = it->claimed_resources.begin();
+    for (; res != it->claimed_resources.end(); ++res)
+    {
+      // state readers claim nothing but need all joints to be read
+      if (res->hardware_interface.find("JointStateInterface") != std::string::npos)
+        controllers_states_.insert(it->name);
+      joints.insert(joints.end(), res->resources.begin(), res->resources.end());
+    }
+  }
+
+  // the running controllers already wrote this tick, the sets change at the next one
+  active_joints_changed_ = true;
+
+  // but the started controllers read the angles right after, refresh the unread ones
+  std::set<std::string> started;
+  bool read_all = false;
+  for (it = start_list.begin(); it != start_list.end(); ++it)
+  {
+    const std::vector<std::string> &joints = controllers_joints_[it->name];
+    started.insert(joints.begin(), joints.end());
+    read_all = read_all || controllers_states_.count(it->name);
+  }
+  refreshAngles(started, read_all);
+}
+
+void Robot::refreshAngles(const std::set<std::string> &joints, const bool &all)
+{
+  std::vector<std::string> names;
+  std::vector<int> indexes;
+  for (int i=0; i<hw_joints_.size(); ++i)
+  {
+    const bool read = (i < hw_read_.size()) && hw_read_[i];
+    if (hw_enabled_.at(i) && !read && (all || joints.count(hw_joints_[i])))
+    {
+      names.push_back(hw_joints_[i]);
+      indexes.push_back(i);
+    }
+  }
+  if (names.empty())
+    return;
+
+  // only the angles, the commands of the other controllers are kept
+  const std::vector<float> angles = memory_->getListData(memory_->initMemoryKeys(names));
+  if (angles.size() != names.size())
+  {
+    ROS_WARN_STREAM("Could not read the angles of the newly claimed joints " << print(names));
+    return;
+  }
+  for (size_t j=0; j<indexes.size(); ++j)
+  {
+    hw_angles_[indexes[j]] = angles[j];
+    hw_velocities_[indexes[j]] = 0.0;
+  }
+}
+
+void Robot::updateActiveJoints()
+{
+  active_joints_changed_ = false;
+  std::set<std::string> claimed;
+  std::map<std::string, std::vector<std::string> >::const_iterator it = controllers_joints_.begin();
+  for (; it != controllers_joints_.end(); ++it)
+    claimed.insert(it->second.begin(), it->second.end());
+  bool read_all = !controllers_states_.empty();
+
+  std::vector<bool> hw_claimed(hw_joints_.size(), false);
+  std::vector<bool> hw_read(hw_joints_.size(), false);
+  for (int i=0; i<hw_joints_.size(); ++i)
+  {
+    if (!hw_enabled_.at(i))
+      continue;
+    hw_claimed[i] = (claimed.find(hw_joints_.at(i)) != claimed.end());
+    hw_read[i] = read_all || hw_claimed[i];
+  }
+
+  // rebuild the write set, the commands and the DCM alias
+  if (hw_claimed != hw_claimed_)
+  {
+    hw_claimed_ = hw_claimed;
+    qi_write_joints_.clear();
+    for (int i=0; i<hw_joints_.size(); ++i)
+      if (hw_claimed_[i])
+        qi_write_joints_.push_back(hw_joints_.at(i));
+
+    qi_commands_.resize(qi_write_joints_.size(), 0.0);
+    qi_vel_commands_.resize(qi_write_joints_.size(), 0.0);
+    motion_->init(qi_write_joints_);
+    if (use_dcm_ && !qi_write_joints_.empty())
+      dcm_->setJoints(qi_write_joints_);
+    ROS_INFO_STREAM("Naoqi written joints are : " << print(qi_write_joints_));
+  }
+
+  // rebuild the read set, the newly read joints have no previous angle
+  if (hw_read != hw_read_)
+  {
+    hw_fresh_.resize(hw_joints_.size(), true);
+    for (int i=0; i<hw_joints_.size(); ++i)
+      if (hw_read[i] && ((i >= hw_read_.size()) || !hw_read_[i]))
+        hw_fresh_[i] = true;
+    hw_read_ = hw_read;
+    qi_read_joints_.clear();
+    for (int i=0; i<hw_joints_.size(); ++i)
+      if (hw_read_[i])
+        qi_read_joints_.push_back(hw_joints_.at(i));
+
+    memory_->setJoints(qi_read_joints_);
+    if (joint_states_group_ >= 0)
+      updateJointStatesKeys();
+    ROS_INFO_STREAM("Naoqi read joints are : " << print(qi_read_joints_));
+  }
 }
 
 void Robot::ignoreMimicJoints(std::vector <std::string> *joints)
@@ -524,10 +1343,164 @@ void Robot::ignoreMimicJoints(std::vector <std::string> *joints)
 //  rewrite by calling DCM rather than ALMotion
 bool Robot::setStiffness(const float &stiffness)
 {
-  stiffness_.data = stiffness;
-
   if (!motion_->stiffnessInterpolation(motor_groups_, stiffness, 2.0f))
     return false;
 
+  // a new message, as the previous one can still be used by subscribers
+  stiffness_ = boost::make_shared<sensor_msgs::JointState>(*stiffness_);
+  std::fill(stiffness_->effort.begin(), stiffness_->effort.end(), stiffness);
+  stiffness_changed_ = true;
+
   return true;
 }
+
+void Robot::updateDerating()
+{
+  const std::vector<bool> &forced = diagnostics_->getForcedJoints();
+  const double step = derating_rate_/controller_freq_;
+  for (size_t i = 0; i < hw_derating_.size(); ++i)
+  {
+    const int j = hw_diagnostics_index_[i];
+    if ((j >= 0) && forced[j])
+      hw_derating_[i] = std::max(hw_derating_[i] - step, derating_stiffness_);
+    else
+      hw_derating_[i] = std::min(hw_derating_[i] + step, 1.0);
+  }
+}
+
+void Robot::writeStiffness()
+{
+  updateDerating();
+
+  qi_stiffness_joints_.clear();
+  qi_stiffness_commands_.clear();
+
+  // compare the effort commands to the applied stiffness
+  std::vector<double>::iterator hw_effort_j = hw_efforts_.begin();
+  std::vector<bool>::iterator hw_enabled_j = hw_enabled_.begin();
+  std::vector<double>::iterator qi_stiffness_j = stiffness_->effort.begin();
+  for(int i=0; hw_effort_j != hw_efforts_.end(); ++i, ++hw_effort_j, ++hw_enabled_j)
+  {
+    if (!*hw_enabled_j)
+      continue;
+
+    double stiffness = std::min(std::max(*hw_effort_j, 0.0), 1.0)*hw_derating_.at(i);
+    if (std::fabs(stiffness - *qi_stiffness_j) > 0.001)
+    {
+      qi_stiffness_joints_.push_back(hw_joints_.at(i));
+      qi_stiffness_commands_.push_back(static_cast<float>(stiffness));
+    }
+    ++qi_stiffness_j;
+  }
+
+  if (qi_stiffness_joints_.empty())
+    return;
+
+  // apply all changes at once, then record them
+  if (!motion_->setStiffnesses(qi_stiffness_joints_, qi_stiffness_commands_))
+    return;
+
+  if (!stiffness_.unique())
+    stiffness_ = boost::make_shared<sensor_msgs::JointState>(*stiffness_);
+
+  std::vector<std::string>::iterator joint_j = qi_stiffness_joints_.begin();
+  std::vector<float>::iterator stiffness_j = qi_stiffness_commands_.begin();
+  std::vector<std::string>::iterator qi_j = stiffness_->name.begin();
+  qi_stiffness_j = stiffness_->effort.begin();
+  for(; joint_j != qi_stiffness_joints_.end(); ++qi_j, ++qi_stiffness_j)
+  {
+    if (*qi_j != *joint_j)
+      continue;
+    *qi_stiffness_j = *stiffness_j;
+    ++joint_j;
+    ++stiffness_j;
+  }
+  stiffness_changed_ = true;
+}
+
+void Robot::publishStiffness(const ros::Time &ts)
+{
+  if (!stiffness_changed_
+      && ((ts - stiffness_->header.stamp).toSec() < stiffness_heartbeat_))
+    return;
+
+  if (!stiffness_.unique())
+    stiffness_ = boost::make_shared<sensor_msgs::JointState>(*stiffness_);
+
+  stiffness_->header.stamp = ts;
+  stiffness_pub_.publish(stiffness_);
+  stiffness_changed_ = false;
+}
+
+void Robot::publishRpcStats(const ros::Time &ts)
+{
+  if ((rpc_stats_period_ <= 0.0)
+      || ((ts - rpc_stats_->header.stamp).toSec() < rpc_stats_period_))
+    return;
+
+  // a new message, as the previous one can still be used by subscribers
+  if (!rpc_stats_.unique())
+    rpc_stats_ = boost::make_shared<diagnostic_msgs::DiagnosticArray>(*rpc_stats_);
+
+  rpc_stats_->header.stamp = ts;
+  RpcStats::instance().fill(rpc_stats_.get());
+  rpc_stats_pub_.publish(rpc_stats_);
+}
+
+void Robot::publishLoopStats(const ros::Time &ts)
+{
+  if ((loop_stats_period_ <= 0.0)
+      || (!loop_stats_last_.isZero() && ((ts - loop_stats_last_).toSec() < loop_stats_period_)))
+    return;
+
+  // the first call only starts the window
+  const bool first = loop_stats_last_.isZero();
+  loop_stats_last_ = ts;
+
+  // a new message, as the previous one can still be used by subscribers
+  if (!loop_stats_msg_.unique())
+    loop_stats_msg_ = boost::make_shared<std_msgs::Float32MultiArray>(*loop_stats_msg_);
+
+  loop_stats_->fill(loop_stats_msg_.get());
+  if (!first)
+    loop_stats_pub_.publish(loop_stats_msg_);
+}
+
+std::map <std::string, std::map <std::string, double> > Robot::getStats()
+{
+  return RpcStats::instance().getSummary();
+}
+
+bool Robot::dumpTrace(const std::string &path)
+{
+  if (!Tracer::instance().isEnabled())
+  {
+    ROS_WARN("The tracing is disabled, set the parameter trace/enabled");
+    return false;
+  }
+  return Tracer::instance().dump(path.empty() ? trace_path_ : path);
+}
+
+void Robot::recordTick()
+{
+  boost::uint32_t flags = 0;
+  if (memory_->isKeysGroupUpdated(0))
+    flags |= FlightRecorder::READ;
+  if (commands_sent_)
+    flags |= FlightRecorder::SENT;
+
+  FlightRecorder::instance().recordTick(loop_stats_->getDurations(), flags,
+                                        hw_angles_, hw_commands_, hw_vel_commands_, hw_efforts_);
+}
+
+void Robot::dumpFlightRecorder(const std::string &reason)
+{
+  if (!FlightRecorder::instance().isEnabled() || flight_recorder_directory_.empty())
+    return;
+
+  // one file per dump, a fault is not overwritten by the stop that follows
+  std::ostringstream path;
+  path << flight_recorder_directory_ << "/naoqi_dcm_driver_flight_"
+       << ros::WallTime::now().toNSec() << ".bin";
+  FlightRecorder::instance().dump(path.str(), reason);
+}
@@ -106,36 +106,7 @@ int main(int argc, char** argv)
   // Deal with ALBrokerManager singleton (add your broker into NAOqi)
   boost::shared_ptr<Robot> robot = boost::make_shared<Robot>(session);
 
-  // stop ALTouch service to prevent the robot shaking
-  try
-  {
-    qi::AnyObject touch_proxy = session->service("ALTouch").value();
-    touch_proxy.call<void>("exit");
-    ROS_INFO_STREAM("Naoqi Touch service is shut down");
-  }
-  catch (const std::exception& e)
-  {
-    ROS_DEBUG("Did not stop ALTouch: %s", e.what());
-  }
-
-  // stop AutonomousLife service to prevent the robot shaking
-  try
-  {
-    qi::AnyObject life_proxy = session->service("ALAutonomousLife").value();
-    if (life_proxy.call<std::string>("getState") != "disabled")
-    {
-      life_proxy.call<void>("setState", "disabled");
-      ROS_INFO_STREAM("Shutting down Naoqi AutonomousLife ...");
-      ros::Duration(2.0).sleep();
-    }
-  }
-  catch (const std::exception& e)
-  {
-    ROS_DEBUG("Did not stop AutonomousLife: %s", e.what());
-  }
-
-  session->registerService("naoqi_dcm_driver", robot);
-  ros::Duration(0.1).sleep();
+  robot->registerService();
 
   if (!robot->connect())
   {
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+// Boost Headers
+#include <boost/thread.hpp>
+
+// ROS Headers
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include "naoqi_dcm_driver/robot.hpp"
+
+namespace naoqi_dcm_driver
+{
+
+/**
+ * @brief This class runs the Robot hardware interface and its loop in a nodelet,
+ * so that co-located nodelets get its messages without serialization
+ */
+class RobotNodelet : public nodelet::Nodelet
+{
+public:
+  RobotNodelet() {}
+
+  //! @brief stop the loop, then the service, and close the session
+  ~RobotNodelet()
+  {
+    // the service is only stopped once the loop no longer uses the robot
+    if (robot_)
+      robot_->stopLoop();
+    if (thread_.joinable())
+      thread_.join();
+    if (robot_)
+      robot_->stopService();
+    if (session_)
+      session_->close();
+  }
+
+private:
+  //! @brief connect to the robot and start the loop
+  void onInit()
+  {
+    ros::NodeHandle &pnh = getMTPrivateNodeHandle();
+
+    int pport = 9559;
+    std::string pip = "127.0.0.1";
+    pnh.getParam("RobotIP", pip);
+    pnh.getParam("RobotPort", pport);
+
+    session_ = qi::makeSession();
+    try
+    {
+      std::stringstream strstr;
+      strstr << "tcp://" << pip << ":" << pport;
+      NODELET_INFO_STREAM("Connecting to " << pip << ":" << pport);
+      session_->connect(strstr.str()).wait();
+    }
+    catch(const std::exception &e)
+    {
+      NODELET_ERROR("Cannot connect to session, %s", e.what());
+      session_->close();
+      return;
+    }
+
+    if (!session_->isConnected())
+    {
+      NODELET_ERROR("Cannot connect to session");
+      session_->close();
+      return;
+    }
+
+    robot_ = boost::make_shared<Robot>(session_, getMTNodeHandle(), pnh, false);
+
+    robot_->registerService();
+
+    if (!robot_->connect())
+    {
+      session_->close();
+      return;
+    }
+
+    // Run the main Loop in its own thread, callbacks run in the nodelet manager
+    thread_ = boost::thread(&Robot::run, robot_);
+  }
+
+  /** Naoqi session pointer */
+  qi::SessionPtr session_;
+
+  /** robot hardware interface */
+  boost::shared_ptr <Robot> robot_;
+
+  /** main loop thread */
+  boost::thread thread_;
+};
+
+} // namespace naoqi_dcm_driver
+
+PLUGINLIB_EXPORT_CLASS(naoqi_dcm_driver::RobotNodelet, nodelet::Nodelet)
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+
+#include "naoqi_dcm_driver/rpc_stats.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+int LatencyHistogram::getBucket(const boost::uint64_t &value)
+{
+  if (value < 16)
+    return static_cast<int>(value);
+
+  int exponent = 63;
+  while (!(value >> exponent))
+    --exponent;
+  if (exponent > 40)
+    return BUCKETS - 1;
+
+  const int sub = static_cast<int>((value >> (exponent - 4)) & 15);
+  return 16 + (exponent - 4)*16 + sub;
+}
+
+boost::uint64_t LatencyHistogram::getBucketValue(const int &bucket)
+{
+  if (bucket < 16)
+    return bucket;
+
+  const int exponent = (bucket - 16)/16 + 4;
+  const boost::uint64_t sub = (bucket - 16)%16;
+  const boost::uint64_t width = static_cast<boost::uint64_t>(1) << (exponent - 4);
+  return ((16 + sub) << (exponent - 4)) + width/2;
+}
+
+void LatencyHistogram::record(const boost::uint64_t &value)
+{
+  buckets_[getBucket(value)].fetch_add(1, boost::memory_order_relaxed);
+  count_.fetch_add(1, boost::memory_order_relaxed);
+  sum_.fetch_add(value, boost::memory_order_relaxed);
+
+  boost::uint64_t max = max_.load(boost::memory_order_relaxed);
+  while ((value > max)
+         && !max_.compare_exchange_weak(max, value, boost::memory_order_relaxed))
+  {
+  }
+}
+
+boost::uint64_t LatencyHistogram::getCount() const
+{
+  return count_.load(boost::memory_order_relaxed);
+}
+
+double LatencyHistogram::getMean() const
+{
+  const boost::uint64_t count = getCount();
+  return count ? static_cast<double>(sum_.load(boost::memory_order_relaxed))/count : 0.0;
+}
+
+boost::uint64_t LatencyHistogram::getMax() const
+{
+  return max_.load(boost::memory_order_relaxed);
+}
+
+boost::uint64_t LatencyHistogram::getPercentile(const double &q) const
+{
+  // the buckets are read without a snapshot, concurrent records only shift the result slightly
+  boost::uint64_t total = 0;
+  for (int i=0; i<BUCKETS; ++i)
+    total += buckets_[i].load(boost::memory_order_relaxed);
+  if (total == 0)
+    return 0;
+
+  const boost::uint64_t rank = static_cast<boost::uint64_t>(q*total + 0.5);
+  boost::uint64_t seen = 0;
+  for (int i=0; i<BUCKETS; ++i)
+  {
+    seen += buckets_[i].load(boost::memory_order_relaxed);
+    if (seen >= std::max(rank, static_cast<boost::uint64_t>(1)))
+      return std::min(getBucketValue(i), getMax());
+  }
+  return getMax();
+}
+
+void LatencyHistogram::reset()
+{
+  for (int i=0; i<BUCKETS; ++i)
+    buckets_[i].store(0, boost::memory_order_relaxed);
+  count_.store(0, boost::memory_order_relaxed);
+  sum_.store(0, boost::memory_order_relaxed);
+  max_.store(0, boost::memory_order_relaxed);
+}
+
+RpcStats::Method::Method():
+  errors(0),
+  timeouts(0)
+{
+}
+
+RpcStats::RpcStats():
+  timeout_(2000000000ull)
+{
+}
+
+RpcStats& RpcStats::instance()
+{
+  static RpcStats stats;
+  return stats;
+}
+
+RpcStats::Method* RpcStats::get(const std::string &method)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  boost::shared_ptr <Method> &res = methods_[method];
+  if (!res)
+  {
+    res = boost::shared_ptr<Method>(new Method());
+    res->name = method;
+  }
+  return res.get();
+}
+
+std::vector <RpcStats::Method*> RpcStats::getMethods()
+{
+  std::vector <Method*> res;
+  boost::mutex::scoped_lock lock(mutex_);
+  res.reserve(methods_.size());
+  std::map <std::string, boost::shared_ptr <Method> >::const_iterator it = methods_.begin();
+  for (; it != methods_.end(); ++it)
+    res.push_back(it->second.get());
+  return res;
+}
+
+std::map <std::string, std::map <std::string, double> > RpcStats::getSummary()
+{
+  std::map <std::string, std::map <std::string, double> > res;
+
+  // the histograms are read outside of the lock, the recorders never take it
+  const std::vector <Method*> methods = getMethods();
+  for (std::vector <Method*>::const_iterator it = methods.begin(); it != methods.end(); ++it)
+  {
+    const Method &method = **it;
+    std::map <std::string, double> &summary = res[method.name];
+    summary["calls"] = static_cast<double>(method.latency.getCount());
+    summary["errors"] = static_cast<double>(method.errors.load(boost::memory_order_relaxed));
+    summary["timeouts"] = static_cast<double>(method.timeouts.load(boost::memory_order_relaxed));
+    summary["mean_us"] = method.latency.getMean()*1e-3;
+    summary["p50_us"] = method.latency.getPercentile(0.5)*1e-3;
+    summary["p90_us"] = method.latency.getPercentile(0.9)*1e-3;
+    summary["p99_us"] = method.latency.getPercentile(0.99)*1e-3;
+    summary["max_us"] = method.latency.getMax()*1e-3;
+  }
+  return res;
+}
+
+void RpcStats::fill(diagnostic_msgs::DiagnosticArray *msg)
+{
+  static const char *keys[8] = {"calls", "errors", "timeouts", "mean_us",
+                                "p50_us", "p90_us", "p99_us", "max_us"};
+
+  const std::vector <Method*> methods = getMethods();
+  msg->status.resize(methods.size());
+
+  std::vector<diagnostic_msgs::DiagnosticStatus>::iterator it_status = msg->status.begin();
+  for (std::vector <Method*>::const_iterator it = methods.begin(); it != methods.end(); ++it, ++it_status)
+  {
+    const Method &method = **it;
+    diagnostic_msgs::DiagnosticStatus &status = *it_status;
+    if ((status.hardware_id != method.name) || (status.values.size() != 8))
+    {
+      status.name = "naoqi_dcm_driver:rpc:" + method.name;
+      status.hardware_id = method.name;
+      status.values.resize(8);
+      for (int i=0; i<8; ++i)
+        status.values[i].key = keys[i];
+    }
+
+    const boost::uint64_t errors = method.errors.load(boost::memory_order_relaxed);
+    const boost::uint64_t timeouts = method.timeouts.load(boost::memory_order_relaxed);
+    status.level = (errors + timeouts > 0) ? diagnostic_msgs::DiagnosticStatus::WARN
+                                           : diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = (errors + timeouts > 0) ? "Failed calls" : "OK";
+
+    formatFloat(static_cast<float>(method.latency.getCount()), &status.values[0].value, 0);
+    formatFloat(static_cast<float>(errors), &status.values[1].value, 0);
+    formatFloat(static_cast<float>(timeouts), &status.values[2].value, 0);
+    formatFloat(static_cast<float>(method.latency.getMean()*1e-3), &status.values[3].value, 1);
+    formatFloat(static_cast<float>(method.latency.getPercentile(0.5)*1e-3), &status.values[4].value, 1);
+    formatFloat(static_cast<float>(method.latency.getPercentile(0.9)*1e-3), &status.values[5].value, 1);
+    formatFloat(static_cast<float>(method.latency.getPercentile(0.99)*1e-3), &status.values[6].value, 1);
+    formatFloat(static_cast<float>(method.latency.getMax()*1e-3), &status.values[7].value, 1);
+  }
+}
+
+void RpcStats::setTimeout(const double &timeout)
+{
+  timeout_.store(static_cast<boost::uint64_t>(timeout*1e9), boost::memory_order_relaxed);
+}
+
+boost::uint64_t RpcStats::getTimeout() const
+{
+  return timeout_.load(boost::memory_order_relaxed);
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include <boost/make_shared.hpp>
+
+#include <tf/transform_datatypes.h>
+
+#include "naoqi_dcm_driver/sensors.hpp"
+
+/** mounting of the Front, Left and Right lasers in base_footprint, as in naoqi_driver */
+static const float LASER_X[3] = {0.056f, -0.018f, -0.018f};
+static const float LASER_Y[3] = {0.0f, 0.090f, -0.090f};
+static const float LASER_COS[3] = {1.0f, std::cos(1.757f), std::cos(-1.757f)};
+static const float LASER_SIN[3] = {0.0f, std::sin(1.757f), std::sin(-1.757f)};
+
+Sensors::Sensors(const boost::shared_ptr<Memory> &memory,
+                 ros::NodeHandle *nh,
+                 const ros::NodeHandle &pnh,
+                 const std::string &prefix,
+                 const int &topic_queue,
+                 const std::string &robot):
+  memory_(memory),
+  nh_(nh),
+  pnh_(pnh),
+  prefix_(prefix),
+  topic_queue_(topic_queue),
+  robot_(robot),
+  imu_(new sensor_msgs::Imu()),
+  imu_group_(-1),
+  imu_decimation_(0),
+  sonars_group_(-1),
+  sonars_decimation_(0),
+  laser_(new sensor_msgs::LaserScan()),
+  laser_group_(-1),
+  laser_decimation_(0)
+{
+}
+
+void Sensors::init()
+{
+  pnh_.getParam("imu_decimation", imu_decimation_);
+
+  if (imu_decimation_ > 0)
+  {
+    // gyroscope, accelerometer, then angles, in this order
+    std::vector <std::string> keys;
+    const char* axes[] = {"X", "Y", "Z"};
+    const char* sensors[] = {"Gyroscope", "Accelerometer", "Angle"};
+    for (int s=0; s<3; ++s)
+      for (int a=0; a<3; ++a)
+        keys.push_back(std::string("Device/SubDeviceList/InertialSensor/") + sensors[s] + axes[a] + "/Sensor/Value");
+    imu_group_ = memory_->addKeysGroup(keys, imu_decimation_);
+
+    std::string frame = "ImuTorsoAccelerometer_frame";
+    pnh_.getParam("imu_frame", frame);
+    imu_->header.frame_id = frame;
+
+    imu_pub_ = nh_->advertise<sensor_msgs::Imu>(prefix_+"imu/torso", topic_queue_);
+  }
+
+  pnh_.getParam("sonars_decimation", sonars_decimation_);
+  if (sonars_decimation_ > 0)
+    initSonars();
+
+  pnh_.getParam("laser_decimation", laser_decimation_);
+  if (laser_decimation_ > 0)
+    initLaser();
+}
+
+void Sensors::initSonars()
+{
+  std::vector <std::string> keys, frames, topics;
+  float min_range, max_range;
+  if ((robot_ == "pepper") || (robot_ == "juliette"))
+  {
+    keys.push_back("Device/SubDeviceList/Platform/Front/Sonar/Sensor/Value");
+    frames.push_back("SonarFront_frame");
+    topics.push_back("sonar/front");
+    keys.push_back("Device/SubDeviceList/Platform/Back/Sonar/Sensor/Value");
+    frames.push_back("SonarBack_frame");
+    topics.push_back("sonar/back");
+    min_range = 0.3f;
+    max_range = 5.0f;
+  }
+  else if (robot_ == "nao")
+  {
+    // values are updated only while ALSonar is subscribed
+    keys.push_back("Device/SubDeviceList/US/Left/Sensor/Value");
+    frames.push_back("LSonar_frame");
+    topics.push_back("sonar/left");
+    keys.push_back("Device/SubDeviceList/US/Right/Sensor/Value");
+    frames.push_back("RSonar_frame");
+    topics.push_back("sonar/right");
+    min_range = 0.25f;
+    max_range = 2.55f;
+  }
+  else
+  {
+    ROS_WARN_STREAM("SENSORS: No sonar known for the robot " << robot_);
+    return;
+  }
+
+  sonars_group_ = memory_->addKeysGroup(keys, sonars_decimation_);
+  for (int i=0; i<keys.size(); ++i)
+  {
+    boost::shared_ptr<sensor_msgs::Range> sonar(new sensor_msgs::Range());
+    sonar->header.frame_id = frames.at(i);
+    sonar->radiation_type = sensor_msgs::Range::ULTRASOUND;
+    sonar->field_of_view = 0.523598776f;
+    sonar->min_range = min_range;
+    sonar->max_range = max_range;
+    sonars_.push_back(sonar);
+    sonars_pub_.push_back(nh_->advertise<sensor_msgs::Range>(prefix_+topics.at(i), topic_queue_));
+  }
+}
+
+void Sensors::initLaser()
+{
+  if ((robot_ != "pepper") && (robot_ != "juliette"))
+  {
+    ROS_WARN_STREAM("SENSORS: No laser known for the robot " << robot_);
+    return;
+  }
+
+  // X and Y of the 15 segments of each laser, in the frame of that laser
+  std::vector <std::string> keys;
+  const char* lasers[] = {"Front", "Left", "Right"};
+  for (int l=0; l<3; ++l)
+  {
+    for (int seg=1; seg<=15; ++seg)
+    {
+      char segment[8];
+      snprintf(segment, sizeof(segment), "Seg%02d", seg);
+      std::string key = std::string("Device/SubDeviceList/Platform/LaserSensor/") + lasers[l]
+          + "/Horizontal/" + segment;
+      keys.push_back(key + "/X/Sensor/Value");
+      keys.push_back(key + "/Y/Sensor/Value");
+    }
+  }
+  laser_group_ = memory_->addKeysGroup(keys, laser_decimation_);
+
+  int bins = 120;
+  std::string frame = "base_footprint";
+  pnh_.getParam("laser_bins", bins);
+  pnh_.getParam("laser_frame", frame);
+  if (bins < 1)
+  {
+    ROS_WARN_STREAM("SENSORS: laser_bins must be at least 1, not " << bins << ", using 120");
+    bins = 120;
+  }
+
+  laser_->header.frame_id = frame;
+  laser_->angle_min = -M_PI;
+  laser_->angle_max = M_PI;
+  laser_->angle_increment = 2.0*M_PI/bins;
+  laser_->range_min = 0.1f;
+  laser_->range_max = 5.0f;
+  laser_->ranges.resize(bins);
+
+  laser_pub_ = nh_->advertise<sensor_msgs::LaserScan>(prefix_+"laser", topic_queue_);
+}
+
+void Sensors::publish(const ros::Time &ts)
+{
+  if (imu_group_ >= 0)
+    publishImu(ts);
+
+  if (sonars_group_ >= 0)
+    publishSonars(ts);
+
+  if (laser_group_ >= 0)
+    publishLaser(ts);
+}
+
+void Sensors::publishImu(const ros::Time &ts)
+{
+  const float *values = memory_->getKeysGroupData(imu_group_);
+  if (values == NULL)
+    return;
+
+  // intra-process subscribers may still hold the last message
+  if (!imu_.unique())
+    imu_ = boost::make_shared<sensor_msgs::Imu>(*imu_);
+
+  imu_->header.stamp = ts;
+  imu_->angular_velocity.x = values[0];
+  imu_->angular_velocity.y = values[1];
+  imu_->angular_velocity.z = values[2];
+  imu_->linear_acceleration.x = values[3];
+  imu_->linear_acceleration.y = values[4];
+  imu_->linear_acceleration.z = values[5];
+  imu_->orientation = tf::createQuaternionMsgFromRollPitchYaw(values[6], values[7], values[8]);
+
+  imu_pub_.publish(imu_);
+}
+
+void Sensors::publishSonars(const ros::Time &ts)
+{
+  const float *values = memory_->getKeysGroupData(sonars_group_);
+  if (values == NULL)
+    return;
+
+  for (int i=0; i<sonars_.size(); ++i)
+  {
+    boost::shared_ptr<sensor_msgs::Range> &sonar = sonars_[i];
+    if (!sonar.unique())
+      sonar = boost::make_shared<sensor_msgs::Range>(*sonar);
+
+    sonar->header.stamp = ts;
+    sonar->range = values[i];
+    sonars_pub_[i].publish(sonar);
+  }
+}
+
+void Sensors::publishLaser(const ros::Time &ts)
+{
+  const float *values = memory_->getKeysGroupData(laser_group_);
+  if (values == NULL)
+    return;
+
+  if (!laser_.unique())
+    laser_ = boost::make_shared<sensor_msgs::LaserScan>(*laser_);
+
+  laser_->header.stamp = ts;
+  std::fill(laser_->ranges.begin(), laser_->ranges.end(), std::numeric_limits<float>::infinity());
+
+  // move each segment to base_footprint, then keep the closest one falling in each bin
+  int bins = laser_->ranges.size();
+  for (int i=0; i<90; i+=2)
+  {
+    const int l = i/30;
+    float x = LASER_X[l] + LASER_COS[l]*values[i] - LASER_SIN[l]*values[i+1];
+    float y = LASER_Y[l] + LASER_SIN[l]*values[i] + LASER_COS[l]*values[i+1];
+    float range = std::sqrt(x*x + y*y);
+    if ((range < laser_->range_min) || (range > laser_->range_max))
+      continue;
+
+    int bin = static_cast<int>((std::atan2(y, x) - laser_->angle_min)/laser_->angle_increment);
+    bin = std::min(std::max(bin, 0), bins-1);
+    laser_->ranges[bin] = std::min(laser_->ranges[bin], range);
+  }
+
+  laser_pub_.publish(laser_);
+}
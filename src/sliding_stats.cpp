@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "naoqi_dcm_driver/sliding_stats.hpp"
+
+SlidingStats::SlidingStats(const int &window,
+                           const double &ema_alpha):
+  samples_(std::max(window, 1)),
+  peaks_(std::max(window, 1)),
+  sum_(0.0),
+  sum_squares_(0.0),
+  since_resum_(0),
+  ema_(0.0),
+  ema_alpha_(ema_alpha)
+{
+}
+
+void SlidingStats::add(const float &value)
+{
+  // drop the oldest sample, and its peak if it is still queued
+  if (samples_.full())
+  {
+    const float oldest = samples_.front();
+    sum_ -= oldest;
+    sum_squares_ -= static_cast<double>(oldest)*oldest;
+    if (!peaks_.empty() && (peaks_.front() == std::fabs(oldest)))
+      peaks_.pop_front();
+  }
+  samples_.push_back(value);
+  sum_ += value;
+  sum_squares_ += static_cast<double>(value)*value;
+
+  // the smaller previous samples can no longer be the peak
+  const float magnitude = std::fabs(value);
+  while (!peaks_.empty() && (peaks_.back() < magnitude))
+    peaks_.pop_back();
+  peaks_.push_back(magnitude);
+
+  // recompute the sums once per window, O(1) amortized
+  if (++since_resum_ >= static_cast<int>(samples_.capacity()))
+  {
+    since_resum_ = 0;
+    sum_ = 0.0;
+    sum_squares_ = 0.0;
+    for (boost::circular_buffer<float>::const_iterator it = samples_.begin(); it != samples_.end(); ++it)
+    {
+      sum_ += *it;
+      sum_squares_ += static_cast<double>(*it)*(*it);
+    }
+  }
+
+  ema_ = (samples_.size() == 1) ? value : ema_ + ema_alpha_*(value - ema_);
+}
+
+float SlidingStats::getMean() const
+{
+  return samples_.empty() ? 0.0f : static_cast<float>(sum_/samples_.size());
+}
+
+float SlidingStats::getRms() const
+{
+  return samples_.empty() ? 0.0f : static_cast<float>(std::sqrt(std::max(sum_squares_, 0.0)/samples_.size()));
+}
+
+float SlidingStats::getPeak() const
+{
+  return peaks_.empty() ? 0.0f : peaks_.front();
+}
+
+float SlidingStats::getEma() const
+{
+  return static_cast<float>(ema_);
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <urdf/model.h>
+
+#include <joint_limits_interface/joint_limits.h>
+#include <joint_limits_interface/joint_limits_rosparam.h>
+#include <joint_limits_interface/joint_limits_urdf.h>
+
+#include "naoqi_dcm_driver/supervisor.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+
+/*
+ * The kernels below work on plain arrays without branches,
+ * so that the compiler can vectorize them
+ */
+static void clampKernel(const int n,
+                        const double freq,
+                        double *pos,
+                        const double *cur,
+                        const double *pos_min,
+                        const double *pos_max,
+                        const double *step_max,
+                        const double *vel_max,
+                        const double *acc_max,
+                        const double *jerk_max,
+                        double *prev_pos,
+                        double *prev_vel,
+                        double *prev_acc)
+{
+  const double dt = 1.0/freq;
+  for (int i=0; i<n; ++i)
+  {
+    const double err = std::min(std::max(pos[i], pos_min[i]), pos_max[i]) - prev_pos[i];
+
+    // the joint must still be able to stop at the target, this is the discrete
+    // form of sqrt(2*acc*|err|) that stays finite with an infinite acceleration
+    const double v_brake = 2.0*std::fabs(err)*freq
+        /(std::sqrt(0.25 + 2.0*std::fabs(err)*freq*freq/acc_max[i]) + 0.5);
+    const double v_max = std::min(vel_max[i], v_brake);
+    double v = std::min(std::max(err*freq, -v_max), v_max);
+
+    double a = (v - prev_vel[i])*freq;
+    a = std::min(std::max(a, prev_acc[i] - jerk_max[i]*dt), prev_acc[i] + jerk_max[i]*dt);
+    a = std::min(std::max(a, -acc_max[i]), acc_max[i]);
+
+    v = std::min(std::max(prev_vel[i] + a*dt, -vel_max[i]), vel_max[i]);
+    double p = std::min(std::max(prev_pos[i] + v*dt, pos_min[i]), pos_max[i]);
+
+    // the step from the measured angle is the hard limit, applied last
+    p = std::min(std::max(p, cur[i] - step_max[i]), cur[i] + step_max[i]);
+    v = (p - prev_pos[i])*freq;
+
+    pos[i] = p;
+    prev_acc[i] = (v - prev_vel[i])*freq;
+    prev_vel[i] = v;
+    prev_pos[i] = p;
+  }
+}
+
+static void clampVelocityKernel(const int n,
+                                const double freq,
+                                double *vel,
+                                const double *vel_max,
+                                const double *acc_max,
+                                double *prev_vel)
+{
+  const double dt = 1.0/freq;
+  for (int i=0; i<n; ++i)
+  {
+    double v = std::min(std::max(vel[i], -vel_max[i]), vel_max[i]);
+    v = std::min(std::max(v, prev_vel[i] - acc_max[i]*dt), prev_vel[i] + acc_max[i]*dt);
+    vel[i] = v;
+    prev_vel[i] = v;
+  }
+}
+
+/*
+ * The velocity is sent as a feedforward, the position being extrapolated
+ * over lead: that target must stay within the position and step limits too
+ */
+static void clampLeadKernel(const int n,
+                            const double lead,
+                            const double *pos,
+                            double *vel,
+                            const double *cur,
+                            const double *pos_min,
+                            const double *pos_max,
+                            const double *step_max)
+{
+  for (int i=0; i<n; ++i)
+  {
+    const double low = std::max(pos_min[i], cur[i] - step_max[i]);
+    const double high = std::min(pos_max[i], cur[i] + step_max[i]);
+    const double target = std::min(std::max(pos[i] + vel[i]*lead, low), high);
+    vel[i] = std::min(std::max((target - pos[i])/lead, std::min(vel[i], 0.0)), std::max(vel[i], 0.0));
+  }
+}
+
+Supervisor::Supervisor(const double &controller_freq):
+  controller_freq_(controller_freq),
+  clamps_changed_(false),
+  initialized_(false)
+{
+}
+
+bool Supervisor::init(const std::vector <std::string> &joints,
+                      const ros::NodeHandle &nh)
+{
+  urdf::Model model;
+  bool has_urdf = model.initParam("robot_description");
+  if (!has_urdf)
+    ROS_WARN("Supervisor: No robot_description, joints limits are read from parameters only");
+
+  double step = 0.0;
+  nh.getParam("command_max_step", step);
+
+  std::vector <joint_limits_interface::JointLimits> limits(joints.size());
+  for (int i=0; i<joints.size(); ++i)
+  {
+    if (has_urdf)
+    {
+      urdf::JointConstSharedPtr joint = model.getJoint(joints.at(i));
+      if (joint)
+        joint_limits_interface::getJointLimits(joint, limits[i]);
+    }
+    joint_limits_interface::getJointLimits(joints.at(i), nh, limits[i]);
+  }
+
+  setLimits(joints, limits, step);
+  return true;
+}
+
+void Supervisor::setLimits(const std::vector <std::string> &joints,
+                           const std::vector <joint_limits_interface::JointLimits> &limits,
+                           const double &step)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  int joints_nbr = joints.size();
+  joints_ = joints;
+
+  pos_min_.assign(joints_nbr, -inf);
+  pos_max_.assign(joints_nbr, inf);
+  vel_max_.assign(joints_nbr, inf);
+  acc_max_.assign(joints_nbr, inf);
+  jerk_max_.assign(joints_nbr, inf);
+  step_max_.assign(joints_nbr, inf);
+  prev_pos_.assign(joints_nbr, 0.0);
+  prev_vel_.assign(joints_nbr, 0.0);
+  prev_acc_.assign(joints_nbr, 0.0);
+  prev_vel_command_.assign(joints_nbr, 0.0);
+  requested_.assign(joints_nbr, 0.0);
+  requested_vel_.assign(joints_nbr, 0.0);
+  clamped_.assign(joints_nbr, false);
+  initialized_ = false;
+
+  for (int i=0; (i<joints_nbr) && (i<limits.size()); ++i)
+  {
+    if (limits[i].has_position_limits)
+    {
+      pos_min_[i] = limits[i].min_position;
+      pos_max_[i] = limits[i].max_position;
+    }
+    if (limits[i].has_velocity_limits)
+      vel_max_[i] = limits[i].max_velocity;
+    if (limits[i].has_acceleration_limits)
+      acc_max_[i] = limits[i].max_acceleration;
+    if (limits[i].has_jerk_limits)
+      jerk_max_[i] = limits[i].max_jerk;
+    if (step > 0.0)
+      step_max_[i] = step;
+  }
+}
+
+int Supervisor::clamp(std::vector <double> *commands,
+                      std::vector <double> *vel_commands,
+                      const std::vector <double> &angles,
+                      const std::vector <bool> &active,
+                      const double &lead)
+{
+  int joints_nbr = joints_.size();
+  if (joints_nbr == 0)
+    return 0;
+
+  if (!initialized_)
+  {
+    prev_pos_ = angles;
+    initialized_ = true;
+  }
+
+  std::copy(commands->begin(), commands->end(), requested_.begin());
+  std::copy(vel_commands->begin(), vel_commands->end(), requested_vel_.begin());
+
+  clampKernel(joints_nbr, controller_freq_, &(*commands)[0], &angles[0],
+              &pos_min_[0], &pos_max_[0], &step_max_[0],
+              &vel_max_[0], &acc_max_[0], &jerk_max_[0],
+              &prev_pos_[0], &prev_vel_[0], &prev_acc_[0]);
+  clampVelocityKernel(joints_nbr, controller_freq_, &(*vel_commands)[0],
+                      &vel_max_[0], &acc_max_[0], &prev_vel_command_[0]);
+  if (lead > 0.0)
+  {
+    clampLeadKernel(joints_nbr, lead, &(*commands)[0], &(*vel_commands)[0], &angles[0],
+                    &pos_min_[0], &pos_max_[0], &step_max_[0]);
+    std::copy(vel_commands->begin(), vel_commands->end(), prev_vel_command_.begin());
+  }
+
+  // joints without commands restart from their current angles
+  int res = 0;
+  clamps_changed_ = false;
+  for (int i=0; i<joints_nbr; ++i)
+  {
+    bool clamped = false;
+    if (!active[i])
+    {
+      prev_pos_[i] = angles[i];
+      prev_vel_[i] = 0.0;
+      prev_acc_[i] = 0.0;
+      prev_vel_command_[i] = 0.0;
+    }
+    else
+      clamped = (std::fabs((*commands)[i] - requested_[i]) > 1e-6)
+          || ((*vel_commands)[i] != requested_vel_[i]);
+    clamps_changed_ = clamps_changed_ || (clamped != clamped_[i]);
+    clamped_[i] = clamped;
+    res += clamped;
+  }
+  return res;
+}
+
+void Supervisor::getClampEvents(diagnostic_msgs::DiagnosticArray *msg)
+{
+  static const char *keys[3] = {"RequestedPosition", "AppliedPosition", "RequestedVelocity"};
+
+  msg->status.resize(std::count(clamped_.begin(), clamped_.end(), true));
+  std::vector<diagnostic_msgs::DiagnosticStatus>::iterator it_status = msg->status.begin();
+  for (int i=0; i<joints_.size(); ++i)
+  {
+    if (!clamped_[i])
+      continue;
+
+    diagnostic_msgs::DiagnosticStatus &status = *it_status++;
+    if ((status.hardware_id != joints_.at(i)) || (status.values.size() != 3))
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.name = std::string("naoqi_dcm_driver:Supervisor:") + joints_.at(i);
+      status.hardware_id = joints_.at(i);
+      status.message = "Command clamped";
+      status.values.resize(3);
+      for (int k=0; k<3; ++k)
+        status.values[k].key = keys[k];
+    }
+
+    formatFloat(static_cast<float>(requested_[i]), &status.values[0].value, 4);
+    formatFloat(static_cast<float>(prev_pos_[i]), &status.values[1].value, 4);
+    formatFloat(static_cast<float>(requested_vel_[i]), &status.values[2].value, 4);
+  }
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "naoqi_dcm_driver/thermal_model.hpp"
+
+/** estimation steps before predicting */
+static const int MIN_ESTIMATIONS = 10;
+
+/** bound of the covariance trace, the trace of the initial covariance */
+static const double MAX_TRACE = 2.001e-2;
+
+ThermalModel::ThermalModel(const double &sample_period,
+                           const double &forgetting):
+  sample_period_(sample_period),
+  forgetting_(forgetting),
+  estimations_(0),
+  start_(-1.0),
+  sum_temperature_(0.0),
+  sum_current2_(0.0),
+  count_(0),
+  previous_time_(-1.0),
+  previous_temperature_(0.0),
+  previous_current2_(0.0),
+  temperature_(0.0),
+  current2_(0.0)
+{
+  // start from a slow cooling towards 30 degrees, time constant of 10 min
+  theta_[0] = 0.0;
+  theta_[1] = 1.0/600.0;
+  theta_[2] = 30.0/600.0;
+
+  for (int i=0; i<3; ++i)
+    for (int j=0; j<3; ++j)
+      p_[i][j] = 0.0;
+  p_[0][0] = 1e-2;
+  p_[1][1] = 1e-5;
+  p_[2][2] = 1e-2;
+}
+
+void ThermalModel::update(const double &time,
+                          const float &temperature,
+                          const float &current)
+{
+  if (start_ < 0.0)
+    start_ = time;
+
+  sum_temperature_ += temperature;
+  sum_current2_ += static_cast<double>(current)*current;
+  ++count_;
+
+  if (time - start_ < sample_period_)
+    return;
+
+  // close the sample period
+  const double sample_time = 0.5*(start_ + time);
+  temperature_ = sum_temperature_/count_;
+  current2_ = sum_current2_/count_;
+
+  if (previous_time_ >= 0.0)
+  {
+    const double y = (temperature_ - previous_temperature_)/(sample_time - previous_time_);
+    const double phi[3] = {0.5*(current2_ + previous_current2_),
+                           -0.5*(temperature_ + previous_temperature_),
+                           1.0};
+    estimate(phi, y);
+  }
+
+  previous_time_ = sample_time;
+  previous_temperature_ = temperature_;
+  previous_current2_ = current2_;
+  start_ = time;
+  sum_temperature_ = 0.0;
+  sum_current2_ = 0.0;
+  count_ = 0;
+}
+
+void ThermalModel::estimate(const double phi[3], const double &y)
+{
+  // k = P*phi / (lambda + phi'*P*phi)
+  double p_phi[3];
+  for (int i=0; i<3; ++i)
+    p_phi[i] = p_[i][0]*phi[0] + p_[i][1]*phi[1] + p_[i][2]*phi[2];
+  const double denominator = forgetting_ + phi[0]*p_phi[0] + phi[1]*p_phi[1] + phi[2]*p_phi[2];
+  if (denominator <= 0.0)
+    return;
+
+  double k[3];
+  for (int i=0; i<3; ++i)
+    k[i] = p_phi[i]/denominator;
+
+  const double error = y - (theta_[0]*phi[0] + theta_[1]*phi[1] + theta_[2]*phi[2]);
+  for (int i=0; i<3; ++i)
+    theta_[i] += k[i]*error;
+
+  // P = (P - k*phi'*P)/lambda, P is symmetric so phi'*P = p_phi'
+  for (int i=0; i<3; ++i)
+    for (int j=0; j<3; ++j)
+      p_[i][j] -= k[i]*p_phi[j];
+
+  // without excitation (idle joint) the forgetting only inflates P, bound its
+  // trace so that the parameters do not swing on the next noisy measure
+  const double trace = p_[0][0] + p_[1][1] + p_[2][2];
+  double scale = 1.0/forgetting_;
+  if (trace*scale > MAX_TRACE)
+    scale = MAX_TRACE/trace;
+  for (int i=0; i<3; ++i)
+    for (int j=0; j<3; ++j)
+      p_[i][j] *= scale;
+
+  ++estimations_;
+}
+
+void ThermalModel::getParameters(double *a, double *b, double *c) const
+{
+  *a = theta_[0];
+  *b = theta_[1];
+  *c = theta_[2];
+}
+
+double ThermalModel::getTimeTo(const float &temperature) const
+{
+  const double infinity = std::numeric_limits<double>::infinity();
+  if (estimations_ < MIN_ESTIMATIONS)
+    return infinity;
+  if (temperature_ >= temperature)
+    return 0.0;
+
+  // heating cannot be negative, and cooling is at least very slow
+  const double heating = std::max(theta_[0], 0.0)*current2_ + theta_[2];
+  const double cooling = std::max(theta_[1], 1e-6);
+
+  // T(t) = T_inf + (T_0 - T_inf)*exp(-b*t), with T_inf = (a*I^2 + c)/b
+  const double steady = heating/cooling;
+  if (steady <= temperature)
+    return infinity;
+  return std::log((steady - temperature_)/(steady - temperature))/cooling;
+}
@@ -15,6 +15,10 @@
  *
 */
 
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
 #include <boost/algorithm/string.hpp>
 
 #include "naoqi_dcm_driver/tools.hpp"
@@ -87,6 +91,25 @@ std::vector<float> fromAnyValueToFloatVector(qi::AnyValue& value)
   return result;
 }
 
+void fromAnyValueToFloatVector(qi::AnyValue& value, std::vector<float> *result)
+{
+  qi::AnyReferenceVector anyrefs = value.asListValuePtr();
+  result->resize(anyrefs.size());
+
+  for(int i=0; i<anyrefs.size(); ++i)
+  {
+    try
+    {
+      (*result)[i] = anyrefs[i].content().toFloat();
+    }
+    catch(std::runtime_error& e)
+    {
+      (*result)[i] = 0.0f;
+      std::cout << e.what() << "=> set to 0.0f" << std::endl;
+    }
+  }
+}
+
 std::vector<int> fromAnyValueToIntVector(qi::AnyValue& value)
 {
   std::vector<int> result;
@@ -118,6 +141,67 @@ std::string print(const std::vector <std::string> &vector)
   return ss.str();
 }
 
+void appendFloat(const float &value, std::string *str, const int &decimals)
+{
+  if (value != value)
+  {
+    str->append("nan");
+    return;
+  }
+
+  double v = value;
+  if (std::fabs(v) >= 1e9 || decimals < 0 || decimals > 6)
+  {
+    char buffer[32];
+    int size = std::snprintf(buffer, sizeof(buffer), "%g", v);
+    str->append(buffer, std::max(0, std::min(size, static_cast<int>(sizeof(buffer)) - 1)));
+    return;
+  }
+
+  long scale = 1;
+  for (int i=0; i<decimals; ++i)
+    scale *= 10;
+  long long n = static_cast<long long>(std::fabs(v) * scale + 0.5);
+  long long integer = n / scale;
+  long fraction = static_cast<long>(n % scale);
+
+  // digits are written backwards from the end of the buffer
+  char buffer[32];
+  char *end = buffer + sizeof(buffer);
+  char *p = end;
+
+  int digits = decimals;
+  while ((digits > 0) && (fraction % 10 == 0))
+  {
+    fraction /= 10;
+    --digits;
+  }
+  if (digits > 0)
+  {
+    for (int i=0; i<digits; ++i, fraction /= 10)
+      *--p = static_cast<char>('0' + fraction % 10);
+    *--p = '.';
+  }
+
+  do
+  {
+    *--p = static_cast<char>('0' + integer % 10);
+    integer /= 10;
+  }
+  while (integer > 0);
+
+  if ((v < 0.0) && (n > 0))
+    *--p = '-';
+
+  str->append(p, end - p);
+}
+
+void formatFloat(const float &value, std::string *str, const int &decimals)
+{
+  str->clear();
+  appendFloat(value, str, decimals);
+}
+
 std::vector <std::string> toVector(const std::string &input)
 {
   std::vector <std::string> value;
@@ -149,3 +233,78 @@ void xmlToVector(XmlRpc::XmlRpcValue &topicList,
       joints->push_back(tmp);
   }
 }
+
+boost::uint64_t monotonicNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<boost::uint64_t>(ts.tv_sec)*1000000000ULL + ts.tv_nsec;
+}
+
+bool waitFor(const boost::function<bool ()> &condition,
+             const double &timeout,
+             const double &period)
+{
+  const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+  while (!condition())
+  {
+    if (ros::WallTime::now() >= deadline)
+      return false;
+    ros::WallDuration(period).sleep();
+  }
+  return true;
+}
+
+void writeString(std::ostream &out, const std::string &str)
+{
+  writeValue(out, static_cast<boost::uint32_t>(str.size()));
+  out.write(str.data(), str.size());
+}
+
+bool readString(std::istream &in, std::string *str)
+{
+  boost::uint32_t size(0);
+  if (!readValue(in, &size) || (size > 4096))
+    return false;
+  str->resize(size);
+  return (size == 0) || static_cast<bool>(in.read(&(*str)[0], size));
+}
+
+void writeStrings(std::ostream &out, const std::vector <std::string> &strs)
+{
+  writeValue(out, static_cast<boost::uint32_t>(strs.size()));
+  for (size_t i=0; i<strs.size(); ++i)
+    writeString(out, strs[i]);
+}
+
+bool readStrings(std::istream &in, std::vector <std::string> *strs)
+{
+  boost::uint32_t size(0);
+  if (!readValue(in, &size) || (size > 4096))
+    return false;
+  strs->resize(size);
+  for (boost::uint32_t i=0; i<size; ++i)
+    if (!readString(in, &(*strs)[i]))
+      return false;
+  return true;
+}
+
+// the file is written to a temporary file then renamed, so that a reader never sees a partial file
+bool openTemporaryFile(const std::string &path, std::ofstream *out)
+{
+  out->open((path + ".tmp").c_str(), std::ios::binary | std::ios::trunc);
+  return static_cast<bool>(*out);
+}
+
+bool replaceFile(const std::string &path, std::ofstream *out)
+{
+  const std::string tmp_path = path + ".tmp";
+  const bool written = static_cast<bool>(out->flush());
+  out->close();
+  if (!written || (std::rename(tmp_path.c_str(), path.c_str()) != 0))
+  {
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
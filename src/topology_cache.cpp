@@ -0,0 +1,134 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <fstream>
+
+#include <boost/cstdint.hpp>
+
+#include <ros/ros.h>
+
+#include "naoqi_dcm_driver/topology_cache.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+
+/*
+ * File layout, integers in host byte order:
+ *   magic, format version, robot, version, parts count,
+ *   then per part: name, names count, names
+ * a string is its length followed by its characters
+ */
+static const boost::uint32_t MAGIC = 0x5444434e; // "NCDT"
+static const boost::uint32_t FORMAT_VERSION = 1;
+
+TopologyCache::TopologyCache(const std::string &path):
+  path_(path)
+{
+}
+
+bool TopologyCache::load(const std::string &robot,
+                         const std::string &version)
+{
+  robot_ = robot;
+  version_ = version;
+  body_names_.clear();
+
+  if (path_.empty())
+    return false;
+
+  std::ifstream in(path_.c_str(), std::ios::binary);
+  if (!in)
+    return false;
+
+  boost::uint32_t magic(0), format(0), parts(0);
+  std::string robot_cached, version_cached;
+  if (!readValue(in, &magic) || (magic != MAGIC)
+      || !readValue(in, &format) || (format != FORMAT_VERSION)
+      || !readString(in, &robot_cached) || !readString(in, &version_cached)
+      || !readValue(in, &parts))
+  {
+    ROS_WARN_STREAM("Ignoring the invalid topology cache " << path_);
+    return false;
+  }
+
+  if ((robot_cached != robot) || (version_cached != version))
+  {
+    ROS_INFO_STREAM("The topology cache " << path_ << " is for another robot or NAOqi version");
+    return false;
+  }
+
+  std::map <std::string, std::vector <std::string> > body_names;
+  for (boost::uint32_t i=0; i<parts; ++i)
+  {
+    std::string part;
+    if (!readString(in, &part) || !readStrings(in, &body_names[part]))
+    {
+      ROS_WARN_STREAM("Ignoring the truncated topology cache " << path_);
+      return false;
+    }
+  }
+
+  body_names_.swap(body_names);
+  return true;
+}
+
+bool TopologyCache::save() const
+{
+  if (path_.empty())
+    return false;
+
+  std::ofstream out;
+  if (!openTemporaryFile(path_, &out))
+  {
+    ROS_WARN_STREAM("Could not write the topology cache " << path_);
+    return false;
+  }
+
+  writeValue(out, MAGIC);
+  writeValue(out, FORMAT_VERSION);
+  writeString(out, robot_);
+  writeString(out, version_);
+  writeValue(out, static_cast<boost::uint32_t>(body_names_.size()));
+
+  std::map <std::string, std::vector <std::string> >::const_iterator it = body_names_.begin();
+  for (; it != body_names_.end(); ++it)
+  {
+    writeString(out, it->first);
+    writeStrings(out, it->second);
+  }
+
+  if (!replaceFile(path_, &out))
+  {
+    ROS_WARN_STREAM("Could not write the topology cache " << path_);
+    return false;
+  }
+  return true;
+}
+
+bool TopologyCache::getBodyNames(const std::string &robot_part,
+                                 std::vector <std::string> *names) const
+{
+  std::map <std::string, std::vector <std::string> >::const_iterator it = body_names_.find(robot_part);
+  if (it == body_names_.end())
+    return false;
+  *names = it->second;
+  return true;
+}
+
+void TopologyCache::setBodyNames(const std::string &robot_part,
+                                 const std::vector <std::string> &names)
+{
+  body_names_[robot_part] = names;
+}
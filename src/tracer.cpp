@@ -0,0 +1,236 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+#include "naoqi_dcm_driver/tracer.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+
+namespace
+{
+/** kernel id of the calling thread, as displayed by top or perf */
+int getThreadId()
+{
+  static __thread int tid = 0;
+  if (tid == 0)
+    tid = static_cast<int>(syscall(SYS_gettid));
+  return tid;
+}
+
+/** name given by the kernel to a thread, empty if it is gone */
+std::string getKernelThreadName(const int &tid)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+  std::ifstream file(path);
+  std::string name;
+  std::getline(file, name);
+  return name;
+}
+
+/** copy of a span, sortable by begin */
+struct Span
+{
+  const char *category;
+  const char *name;
+  boost::uint64_t start;
+  boost::uint64_t end;
+  int tid;
+  bool async;
+
+  bool operator<(const Span &other) const
+  {
+    return start < other.start;
+  }
+};
+
+void writeString(FILE *file, const std::string &str)
+{
+  fputc('"', file);
+  for (size_t i=0; i<str.size(); ++i)
+  {
+    if ((str[i] == '"') || (str[i] == '\\'))
+      fputc('\\', file);
+    if (static_cast<unsigned char>(str[i]) >= 0x20)
+      fputc(str[i], file);
+  }
+  fputc('"', file);
+}
+}
+
+Tracer::Tracer():
+  capacity_(0),
+  head_(0),
+  enabled_(false)
+{
+}
+
+Tracer& Tracer::instance()
+{
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::enable(const size_t &capacity)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!events_ && (capacity > 0))
+  {
+    events_.reset(new Event[capacity]);
+    for (size_t i=0; i<capacity; ++i)
+      events_[i].sequence.store(0, boost::memory_order_relaxed);
+    capacity_ = capacity;
+  }
+  if (events_)
+    enabled_.store(true, boost::memory_order_release);
+}
+
+void Tracer::record(const char *category,
+                    const char *name,
+                    const boost::uint64_t &start,
+                    const boost::uint64_t &end,
+                    const bool &async)
+{
+  if (!isEnabled())
+    return;
+
+  const boost::uint64_t index = head_.fetch_add(1, boost::memory_order_relaxed);
+  Event &event = events_[index % capacity_];
+
+  // the readers skip the slot until its sequence is set again
+  event.sequence.store(0, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+  event.category = category;
+  event.name = name;
+  event.start = start;
+  event.end = end;
+  event.tid = getThreadId();
+  event.async = async;
+  event.sequence.store(index + 1, boost::memory_order_release);
+}
+
+void Tracer::setThreadName(const std::string &name)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  threads_names_[getThreadId()] = name;
+}
+
+bool Tracer::dump(const std::string &path)
+{
+  if (!isEnabled())
+    return false;
+
+  // copy the consistent slots, the writers keep going meanwhile
+  std::vector <Span> spans;
+  spans.reserve(capacity_);
+  for (size_t i=0; i<capacity_; ++i)
+  {
+    const Event &event = events_[i];
+    const boost::uint64_t sequence = event.sequence.load(boost::memory_order_acquire);
+    Span span;
+    span.category = event.category;
+    span.name = event.name;
+    span.start = event.start;
+    span.end = event.end;
+    span.tid = event.tid;
+    span.async = event.async;
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    if ((sequence != 0) && (sequence == event.sequence.load(boost::memory_order_relaxed)))
+      spans.push_back(span);
+  }
+  std::sort(spans.begin(), spans.end());
+
+  FILE *file = fopen(path.c_str(), "w");
+  if (!file)
+  {
+    ROS_ERROR("Could not write the trace to %s", path.c_str());
+    return false;
+  }
+
+  const int pid = static_cast<int>(getpid());
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+  std::set <int> tids;
+  for (size_t i=0; i<spans.size(); ++i)
+    tids.insert(spans[i].tid);
+
+  bool first = true;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for (std::set<int>::const_iterator it = tids.begin(); it != tids.end(); ++it)
+    {
+      std::map<int, std::string>::const_iterator it_name = threads_names_.find(*it);
+      const std::string name = (it_name != threads_names_.end()) ? it_name->second
+                                                                 : getKernelThreadName(*it);
+      fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+              first ? "" : ",\n", pid, *it);
+      writeString(file, name.empty() ? "thread" : name);
+      fprintf(file, "}}");
+      first = false;
+    }
+  }
+
+  // the asynchronous calls overlap, they are displayed as async events
+  for (size_t i=0; i<spans.size(); ++i)
+  {
+    const Span &span = spans[i];
+    if (span.async)
+    {
+      fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"b\",\"id\":%lu,\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+              first ? "" : ",\n", span.name, span.category, static_cast<unsigned long>(i),
+              span.start*1e-3, pid, span.tid);
+      fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"e\",\"id\":%lu,\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+              span.name, span.category, static_cast<unsigned long>(i),
+              span.end*1e-3, pid, span.tid);
+    }
+    else
+      fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+              first ? "" : ",\n", span.name, span.category,
+              span.start*1e-3, (span.end - span.start)*1e-3, pid, span.tid);
+    first = false;
+  }
+
+  fprintf(file, "\n]}\n");
+  const bool res = (fclose(file) == 0);
+  if (res)
+    ROS_INFO("Trace of %lu spans written to %s", static_cast<unsigned long>(spans.size()), path.c_str());
+  else
+    ROS_ERROR("Could not write the trace to %s", path.c_str());
+  return res;
+}
+
+TraceSpan::TraceSpan(const char *category, const char *name):
+  category_(category),
+  name_(name),
+  start_(Tracer::instance().isEnabled() ? monotonicNs() : 0)
+{
+}
+
+TraceSpan::~TraceSpan()
+{
+  if (start_ != 0)
+    Tracer::instance().record(category_, name_, start_, monotonicNs());
+}
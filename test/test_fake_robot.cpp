@@ -0,0 +1,223 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+#include <controller_manager_msgs/LoadController.h>
+#include <controller_manager_msgs/SwitchController.h>
+#include <sensor_msgs/JointState.h>
+#include <std_msgs/Float64MultiArray.h>
+
+#include "naoqi_dcm_driver/fake_services.hpp"
+#include "naoqi_dcm_driver/robot.hpp"
+#include "naoqi_dcm_driver/rpc_stats.hpp"
+#include "naoqi_dcm_driver/tools.hpp"
+
+/*
+ * The driver connects to the stand-in services of this process and runs
+ * its loop, the head being commanded by the position controller of
+ * fake_robot.test. The faults are injected in the plant between the tests
+ */
+
+/** tolerance on the reached angles [rad] */
+static const double TOLERANCE = 0.02;
+
+/** time given to the head to reach a target [s] */
+static const double TIMEOUT = 5.0;
+
+static boost::shared_ptr <FakeRobot> plant;
+static ros::Publisher command_pub;
+
+/** last joint states received, and their count */
+static boost::mutex joint_states_mutex;
+static sensor_msgs::JointState joint_states;
+static int joint_states_count(0);
+
+static void onJointStates(const sensor_msgs::JointStateConstPtr &msg)
+{
+  boost::mutex::scoped_lock lock(joint_states_mutex);
+  joint_states = *msg;
+  ++joint_states_count;
+}
+
+static int getJointStatesCount()
+{
+  boost::mutex::scoped_lock lock(joint_states_mutex);
+  return joint_states_count;
+}
+
+static bool haveJointStates()
+{
+  return getJointStatesCount() > 0;
+}
+
+static bool isCommandListened()
+{
+  return command_pub.getNumSubscribers() > 0;
+}
+
+//! @brief check that the last joint states have the head at yaw, pitch
+static bool isHeadAt(const double &yaw, const double &pitch)
+{
+  boost::mutex::scoped_lock lock(joint_states_mutex);
+  int found(0);
+  for (size_t i=0; (i<joint_states.name.size()) && (i<joint_states.position.size()); ++i)
+  {
+    if (joint_states.name[i] == "HeadYaw")
+      found += (std::fabs(joint_states.position[i] - yaw) < TOLERANCE);
+    else if (joint_states.name[i] == "HeadPitch")
+      found += (std::fabs(joint_states.position[i] - pitch) < TOLERANCE);
+  }
+  return found == 2;
+}
+
+static void commandHead(const double &yaw, const double &pitch)
+{
+  std_msgs::Float64MultiArray command;
+  command.data.push_back(yaw);
+  command.data.push_back(pitch);
+  command_pub.publish(command);
+}
+
+//! @brief command the head and wait for the joint states to reach it
+static bool moveHead(const double &yaw, const double &pitch)
+{
+  commandHead(yaw, pitch);
+  return waitFor(boost::bind(&isHeadAt, yaw, pitch), TIMEOUT);
+}
+
+//! @brief load and start a controller through the controller manager services
+static bool startController(const std::string &name)
+{
+  controller_manager_msgs::LoadController load;
+  load.request.name = name;
+  controller_manager_msgs::SwitchController sw;
+  sw.request.start_controllers.push_back(name);
+  sw.request.strictness = controller_manager_msgs::SwitchController::Request::STRICT;
+  return ros::service::waitForService("controller_manager/load_controller", ros::Duration(TIMEOUT))
+      && ros::service::call("controller_manager/load_controller", load) && load.response.ok
+      && ros::service::call("controller_manager/switch_controller", sw) && sw.response.ok;
+}
+
+static double getRpcTimeout()
+{
+  double timeout(2.0);
+  ros::param::get("~rpc_timeout", timeout);
+  return timeout;
+}
+
+TEST(FakeRobot, JointStatesFollowCommands)
+{
+  ASSERT_TRUE(moveHead(0.3, -0.1));
+  ASSERT_TRUE(moveHead(-0.2, 0.2));
+}
+
+TEST(FakeRobot, FailedWritesKeepTheLoopRunning)
+{
+  ASSERT_TRUE(moveHead(0.3, -0.1));
+  RpcStats::Method *const set_angles = RpcStats::instance().get("setAngles");
+  const boost::uint64_t errors = set_angles->errors.load();
+
+  FakeRobot::Faults faults;
+  faults.failing.insert("ALMotion.setAngles");
+  plant->setFaults(faults);
+
+  // the joint states are still published, the head stays where it was
+  const int count = getJointStatesCount();
+  commandHead(-0.3, 0.1);
+  ros::WallDuration(1.0).sleep();
+  EXPECT_GT(getJointStatesCount(), count + 3);
+  EXPECT_TRUE(isHeadAt(0.3, -0.1));
+  EXPECT_GT(set_angles->errors.load(), errors);
+
+  plant->setFaults(FakeRobot::Faults());
+  EXPECT_TRUE(waitFor(boost::bind(&isHeadAt, -0.3, 0.1), TIMEOUT));
+}
+
+TEST(FakeRobot, StalledWritesKeepTheLoopRunning)
+{
+  ASSERT_TRUE(moveHead(0.3, -0.1));
+  RpcStats::Method *const set_angles = RpcStats::instance().get("setAngles");
+  const boost::uint64_t timeouts = set_angles->timeouts.load();
+
+  FakeRobot::Faults faults;
+  faults.stalling.insert("ALMotion.setAngles");
+  faults.stall_duration = 1.5*getRpcTimeout();
+  plant->setFaults(faults);
+
+  // the writes are not waited for, the loop keeps its rate and the head moves late
+  const int count = getJointStatesCount();
+  commandHead(-0.3, 0.1);
+  ros::WallDuration(1.0).sleep();
+  EXPECT_GT(getJointStatesCount(), count + 3);
+  EXPECT_GT(set_angles->timeouts.load(), timeouts);
+
+  plant->setFaults(FakeRobot::Faults());
+  EXPECT_TRUE(waitFor(boost::bind(&isHeadAt, -0.3, 0.1), TIMEOUT));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "test_fake_robot");
+  ros::NodeHandle nh;
+
+  // serve the stand-in services on a free port
+  plant = boost::make_shared<FakeRobot>("pepper");
+  qi::SessionPtr server = qi::makeSession();
+  server->listenStandalone("tcp://127.0.0.1:0").value();
+  if (!registerFakeServices(server, plant))
+    return -1;
+
+  // the driver connects through its own session, as to a robot
+  qi::SessionPtr session = qi::makeSession();
+  session->connect(server->endpoints().at(0)).value();
+  boost::shared_ptr<Robot> robot = boost::make_shared<Robot>(session, nh, ros::NodeHandle("~"), false);
+  if (!robot->connect())
+    return -1;
+
+  ros::AsyncSpinner spinner(2);
+  spinner.start();
+  boost::thread loop(&Robot::run, robot.get());
+
+  ros::Subscriber joint_states_sub = nh.subscribe("/joint_states", 10, &onJointStates);
+  command_pub = nh.advertise<std_msgs::Float64MultiArray>("head_controller/command", 1);
+
+  int res = -1;
+  if (!startController("head_controller"))
+    ROS_ERROR("Could not start the head controller");
+  else if (!waitFor(&haveJointStates, TIMEOUT) || !waitFor(&isCommandListened, TIMEOUT))
+    ROS_ERROR("The driver does not publish the joint states or listen to the commands");
+  else
+    res = RUN_ALL_TESTS();
+
+  robot->stopLoop();
+  loop.join();
+  robot->stopService();
+  spinner.stop();
+  session->close();
+  server->close();
+  return res;
+}
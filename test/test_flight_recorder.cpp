@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <ros/time.h>
+
+#include "naoqi_dcm_driver/flight_recorder.hpp"
+
+/** methods of the recorded calls, they must outlive the recorder */
+static const std::string GET_TIME("getTime");
+static const std::string SET_ALIAS("setAlias");
+
+static std::string getDumpPath()
+{
+  std::ostringstream path;
+  path << "/tmp/test_flight_recorder_" << getpid() << ".bin";
+  return path.str();
+}
+
+//! @brief record a few ticks and calls, the ticks buffer wrapping around
+static void record(FlightRecorder *recorder,
+                   const std::vector <std::string> &joints)
+{
+  recorder->enable(4, joints, 8);
+
+  boost::uint64_t durations[LoopStats::STAGES];
+  for (int i=0; i<LoopStats::STAGES; ++i)
+    durations[i] = 1000*(i + 1);
+
+  for (int t=0; t<6; ++t)
+  {
+    std::vector <double> positions, commands, velocity_commands, efforts;
+    for (size_t j=0; j<joints.size(); ++j)
+    {
+      positions.push_back(t + 0.1*j);
+      commands.push_back(t + 0.2*j);
+      velocity_commands.push_back(0.5*j);
+      efforts.push_back(0.25);
+    }
+    recorder->recordTick(durations, FlightRecorder::READ | FlightRecorder::SENT,
+                         positions, commands, velocity_commands, efforts);
+  }
+
+  recorder->recordRpc(&GET_TIME, 10, 20, FlightRecorder::OK);
+  recorder->recordRpc(&SET_ALIAS, 30, 40, FlightRecorder::TIMEOUT);
+}
+
+TEST(FlightRecorder, DumpLoadRoundTrip)
+{
+  std::vector <std::string> joints;
+  joints.push_back("HeadYaw");
+  joints.push_back("HeadPitch");
+
+  FlightRecorder &recorder = FlightRecorder::instance();
+  record(&recorder, joints);
+
+  const std::string path = getDumpPath();
+  ASSERT_TRUE(recorder.dump(path, "test"));
+
+  FlightRecorder::Recording recording;
+  ASSERT_TRUE(FlightRecorder::load(path, &recording));
+  std::remove(path.c_str());
+
+  EXPECT_EQ("test", recording.reason);
+  EXPECT_EQ(joints, recording.joints);
+  ASSERT_EQ(static_cast<size_t>(LoopStats::STAGES), recording.stages.size());
+
+  // only the last 4 ticks are kept, the numbering goes on across the tests
+  ASSERT_EQ(4u, recording.ticks.size());
+  for (size_t i=0; i<recording.ticks.size(); ++i)
+  {
+    const FlightRecorder::Tick &tick = recording.ticks[i];
+    EXPECT_EQ(recording.ticks[0].number + i, tick.number);
+    EXPECT_EQ(i + 2, tick.number % 6);
+    EXPECT_EQ(static_cast<boost::uint32_t>(FlightRecorder::READ | FlightRecorder::SENT), tick.flags);
+    ASSERT_EQ(recording.stages.size(), tick.durations.size());
+    EXPECT_EQ(1000u, tick.durations[0]);
+    ASSERT_EQ(joints.size()*FlightRecorder::VALUES, tick.values.size());
+    const float *values = &tick.values[FlightRecorder::VALUES];
+    EXPECT_FLOAT_EQ(i + 2.1f, values[FlightRecorder::POSITION]);
+    EXPECT_FLOAT_EQ(i + 2.2f, values[FlightRecorder::COMMAND]);
+    EXPECT_FLOAT_EQ(0.5f, values[FlightRecorder::VELOCITY_COMMAND]);
+    EXPECT_FLOAT_EQ(0.25f, values[FlightRecorder::EFFORT]);
+  }
+
+  ASSERT_LE(2u, recording.rpcs.size());
+  const FlightRecorder::Rpc &get_time = recording.rpcs[recording.rpcs.size() - 2];
+  EXPECT_EQ(GET_TIME, get_time.method);
+  EXPECT_EQ(10u, get_time.start);
+  EXPECT_EQ(20u, get_time.end);
+  EXPECT_EQ(static_cast<boost::uint32_t>(FlightRecorder::OK), get_time.status);
+  const FlightRecorder::Rpc &set_alias = recording.rpcs.back();
+  EXPECT_EQ(SET_ALIAS, set_alias.method);
+  EXPECT_EQ(static_cast<boost::uint32_t>(FlightRecorder::TIMEOUT), set_alias.status);
+}
+
+TEST(FlightRecorder, TruncatedDumpIsRejected)
+{
+  std::vector <std::string> joints;
+  joints.push_back("HeadYaw");
+  joints.push_back("HeadPitch");
+
+  FlightRecorder &recorder = FlightRecorder::instance();
+  record(&recorder, joints);
+
+  const std::string path = getDumpPath();
+  ASSERT_TRUE(recorder.dump(path, "test"));
+
+  std::string data;
+  {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  ASSERT_FALSE(data.empty());
+
+  // a dump cut anywhere, even inside its header or its counts, is never loaded
+  for (size_t size=0; size<data.size(); ++size)
+  {
+    {
+      std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+      out.write(data.data(), size);
+    }
+    FlightRecorder::Recording recording;
+    EXPECT_FALSE(FlightRecorder::load(path, &recording)) << "truncated to " << size << " bytes";
+  }
+  std::remove(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
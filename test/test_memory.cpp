@@ -0,0 +1,141 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <string>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+
+#include <gtest/gtest.h>
+
+#include "naoqi_dcm_driver/fake_services.hpp"
+#include "naoqi_dcm_driver/memory.hpp"
+#include "naoqi_dcm_driver/rpc_stats.hpp"
+
+/*
+ * The memory reads a stand-in ALMemory object directly, without a session,
+ * its keys being forced to known values
+ */
+
+static std::vector <std::string> makeKeys(const std::string &key1, const std::string &key2 = "")
+{
+  std::vector <std::string> keys(1, key1);
+  if (!key2.empty())
+    keys.push_back(key2);
+  return keys;
+}
+
+static qi::AnyObject makeProxy(const boost::shared_ptr <FakeRobot> &plant)
+{
+  return qi::AnyObject(boost::make_shared<FakeMemory>(plant));
+}
+
+static boost::uint64_t getListDataCalls()
+{
+  return RpcStats::instance().get("getListData")->latency.getCount();
+}
+
+TEST(Memory, GroupsAreReadAtTheirDecimation)
+{
+  boost::shared_ptr <FakeRobot> plant = boost::make_shared<FakeRobot>("pepper");
+  plant->setData("Test/A", 1.0f);
+  plant->setData("Test/B1", 2.0f);
+  plant->setData("Test/B2", 3.0f);
+  plant->setData("Test/C", 4.0f);
+
+  Memory memory(makeProxy(plant));
+  memory.init(makeKeys("HeadYaw", "HeadPitch"));
+  const int a = memory.addKeysGroup(makeKeys("Test/A"), 2);
+  const int b = memory.addKeysGroup(makeKeys("Test/B1", "Test/B2"), 3);
+  const int c = memory.addKeysGroup(makeKeys("Test/C"), 0);
+
+  for (int tick=0; tick<12; ++tick)
+  {
+    // the due groups are read together, in a single request
+    const boost::uint64_t calls = getListDataCalls();
+    ASSERT_TRUE(memory.update()) << "at tick " << tick;
+    EXPECT_EQ(calls + 1, getListDataCalls()) << "at tick " << tick;
+
+    EXPECT_TRUE(memory.isKeysGroupUpdated(0));
+    EXPECT_TRUE(memory.getKeysGroupData(0) != NULL);
+
+    EXPECT_EQ(tick % 2 == 0, memory.isKeysGroupUpdated(a)) << "at tick " << tick;
+    const float *values_a = memory.getKeysGroupData(a);
+    EXPECT_EQ(tick % 2 == 0, values_a != NULL) << "at tick " << tick;
+    if (values_a)
+      EXPECT_EQ(1.0f, values_a[0]);
+
+    EXPECT_EQ(tick % 3 == 0, memory.isKeysGroupUpdated(b)) << "at tick " << tick;
+    const float *values_b = memory.getKeysGroupData(b);
+    EXPECT_EQ(tick % 3 == 0, values_b != NULL) << "at tick " << tick;
+    if (values_b)
+    {
+      EXPECT_EQ(2.0f, values_b[0]);
+      EXPECT_EQ(3.0f, values_b[1]);
+    }
+
+    // a decimation of 0 is never read
+    EXPECT_FALSE(memory.isKeysGroupUpdated(c));
+    EXPECT_TRUE(memory.getKeysGroupData(c) == NULL);
+  }
+
+  // new keys are read from the next update
+  memory.setKeysGroup(a, makeKeys("Test/C"));
+  ASSERT_TRUE(memory.update());
+  ASSERT_TRUE(memory.getKeysGroupData(a) != NULL);
+  EXPECT_EQ(4.0f, memory.getKeysGroupData(a)[0]);
+}
+
+TEST(Memory, NothingIsRequestedWhenNoGroupIsDue)
+{
+  boost::shared_ptr <FakeRobot> plant = boost::make_shared<FakeRobot>("pepper");
+  Memory memory(makeProxy(plant));
+  const int a = memory.addKeysGroup(makeKeys("Test/A"), 2);
+
+  // the joints group is empty until joints are claimed
+  const boost::uint64_t calls = getListDataCalls();
+  ASSERT_TRUE(memory.update());
+  EXPECT_TRUE(memory.isKeysGroupUpdated(a));
+  EXPECT_TRUE(memory.getKeysGroupData(0) == NULL);
+  ASSERT_TRUE(memory.update());
+  EXPECT_FALSE(memory.isKeysGroupUpdated(a));
+  EXPECT_EQ(calls + 1, getListDataCalls());
+}
+
+TEST(Memory, FailedReadsAreReported)
+{
+  boost::shared_ptr <FakeRobot> plant = boost::make_shared<FakeRobot>("pepper");
+  Memory memory(makeProxy(plant));
+  memory.init(makeKeys("HeadYaw"));
+
+  FakeRobot::Faults faults;
+  faults.failing.insert("ALMemory.getListData");
+  plant->setFaults(faults);
+  EXPECT_FALSE(memory.update());
+  EXPECT_FALSE(memory.isKeysGroupUpdated(0));
+  EXPECT_TRUE(memory.getKeysGroupData(0) == NULL);
+
+  plant->setFaults(FakeRobot::Faults());
+  EXPECT_TRUE(memory.update());
+  EXPECT_TRUE(memory.isKeysGroupUpdated(0));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
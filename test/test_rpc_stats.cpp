@@ -0,0 +1,109 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "naoqi_dcm_driver/rpc_stats.hpp"
+
+/** relative bound of a percentile, a bucket spans 1/16 of its power of two */
+static const double PRECISION = 1.0/16.0;
+
+TEST(LatencyHistogram, EmptyHistogram)
+{
+  LatencyHistogram histogram;
+  EXPECT_EQ(0u, histogram.getCount());
+  EXPECT_EQ(0.0, histogram.getMean());
+  EXPECT_EQ(0u, histogram.getMax());
+  EXPECT_EQ(0u, histogram.getPercentile(0.5));
+}
+
+TEST(LatencyHistogram, SmallValuesAreExact)
+{
+  LatencyHistogram histogram;
+  for (boost::uint64_t v=0; v<16; ++v)
+    histogram.record(v);
+  EXPECT_EQ(16u, histogram.getCount());
+  EXPECT_DOUBLE_EQ(7.5, histogram.getMean());
+  EXPECT_EQ(0u, histogram.getPercentile(0.0));
+  EXPECT_EQ(7u, histogram.getPercentile(0.5));
+  EXPECT_EQ(15u, histogram.getPercentile(1.0));
+}
+
+TEST(LatencyHistogram, PercentileIsWithinItsBucket)
+{
+  // both sides of each power of two, and values in between
+  boost::uint64_t previous = 0;
+  for (int exponent=4; exponent<=40; ++exponent)
+  {
+    const boost::uint64_t power = static_cast<boost::uint64_t>(1) << exponent;
+    const boost::uint64_t values[] = {power - 1, power, power + power/3};
+    for (int i=0; i<3; ++i)
+    {
+      LatencyHistogram histogram;
+      histogram.record(values[i]);
+      const boost::uint64_t p = histogram.getPercentile(0.5);
+      EXPECT_LE(p, values[i]) << values[i];
+      EXPECT_LE(std::fabs(static_cast<double>(p) - values[i]), PRECISION*values[i]) << values[i];
+      EXPECT_GE(p, previous) << values[i];
+      previous = p;
+    }
+  }
+}
+
+TEST(LatencyHistogram, LargeValuesAreSaturated)
+{
+  LatencyHistogram histogram;
+  const boost::uint64_t value = static_cast<boost::uint64_t>(1) << 50;
+  histogram.record(value);
+  EXPECT_EQ(value, histogram.getMax());
+  EXPECT_LE(histogram.getPercentile(1.0), value);
+  EXPECT_GE(histogram.getPercentile(1.0), static_cast<boost::uint64_t>(1) << 40);
+}
+
+TEST(LatencyHistogram, PercentilesOfUniformLatencies)
+{
+  // 1 to 1000 us
+  LatencyHistogram histogram;
+  for (boost::uint64_t us=1; us<=1000; ++us)
+    histogram.record(us*1000);
+
+  const double quantiles[] = {0.5, 0.9, 0.99};
+  boost::uint64_t previous = 0;
+  for (int i=0; i<3; ++i)
+  {
+    const double expected = quantiles[i]*1000000.0;
+    const boost::uint64_t p = histogram.getPercentile(quantiles[i]);
+    EXPECT_LE(std::fabs(p - expected), PRECISION*expected) << quantiles[i];
+    EXPECT_GE(p, previous);
+    previous = p;
+  }
+  EXPECT_LE(previous, histogram.getMax());
+  EXPECT_EQ(1000000u, histogram.getMax());
+  EXPECT_DOUBLE_EQ(500500.0, histogram.getMean());
+
+  histogram.reset();
+  EXPECT_EQ(0u, histogram.getCount());
+  EXPECT_EQ(0u, histogram.getPercentile(0.99));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+#include <gtest/gtest.h>
+
+#include "naoqi_dcm_driver/sliding_stats.hpp"
+
+//! @brief compare the statistics with the ones computed over the whole window
+static void expectWindow(const SlidingStats &stats, const std::deque <float> &window, const int &sample)
+{
+  double sum(0.0), sum_squares(0.0);
+  float peak(0.0f);
+  for (size_t i=0; i<window.size(); ++i)
+  {
+    sum += window[i];
+    sum_squares += static_cast<double>(window[i])*window[i];
+    peak = std::max(peak, std::fabs(window[i]));
+  }
+  ASSERT_EQ(peak, stats.getPeak()) << "at sample " << sample;
+  ASSERT_NEAR(sum/window.size(), stats.getMean(), 1e-4) << "at sample " << sample;
+  ASSERT_NEAR(std::sqrt(sum_squares/window.size()), stats.getRms(), 1e-4) << "at sample " << sample;
+}
+
+//! @brief feed a pseudo-random signal, quantized so that the peaks are often tied
+static void checkRandomSignal(const int &window_size)
+{
+  SlidingStats stats(window_size);
+  std::deque <float> window;
+  unsigned int seed = 12345;
+  for (int i=0; i<5000; ++i)
+  {
+    seed = seed*1103515245u + 12345u;
+    const float value = static_cast<int>((seed >> 16) % 21) - 10;
+    stats.add(value);
+    window.push_back(value);
+    if (static_cast<int>(window.size()) > window_size)
+      window.pop_front();
+    expectWindow(stats, window, i);
+    if (testing::Test::HasFatalFailure())
+      return;
+  }
+}
+
+TEST(SlidingStats, Empty)
+{
+  SlidingStats stats;
+  EXPECT_EQ(0.0f, stats.getMean());
+  EXPECT_EQ(0.0f, stats.getRms());
+  EXPECT_EQ(0.0f, stats.getPeak());
+}
+
+TEST(SlidingStats, WindowOfOne)
+{
+  checkRandomSignal(1);
+}
+
+TEST(SlidingStats, SmallWindow)
+{
+  checkRandomSignal(5);
+}
+
+TEST(SlidingStats, DefaultWindow)
+{
+  checkRandomSignal(150);
+}
+
+TEST(SlidingStats, PeakLeavesTheWindow)
+{
+  // a single spike is the peak for exactly one window, with either sign
+  SlidingStats stats(10);
+  stats.add(-8.0f);
+  for (int i=1; i<10; ++i)
+  {
+    stats.add(1.0f);
+    EXPECT_EQ(8.0f, stats.getPeak());
+  }
+  stats.add(1.0f);
+  EXPECT_EQ(1.0f, stats.getPeak());
+}
+
+TEST(SlidingStats, DecreasingSignal)
+{
+  // every sample stays queued, the front leaves at each step
+  SlidingStats stats(20);
+  for (int i=0; i<100; ++i)
+  {
+    stats.add(100.0f - i);
+    EXPECT_EQ(100.0f - std::max(i - 19, 0), stats.getPeak());
+  }
+}
+
+TEST(SlidingStats, NoDriftOnLongRuns)
+{
+  // a large offset with small variations, the incremental sums are recomputed each window
+  SlidingStats stats(150);
+  for (int i=0; i<1000000; ++i)
+    stats.add(1000.0f + ((i % 2) ? 0.001f : -0.001f));
+  EXPECT_NEAR(1000.0f, stats.getMean(), 1e-3);
+  EXPECT_NEAR(1000.0f, stats.getRms(), 1e-3);
+}
+
+TEST(SlidingStats, ExponentialMovingAverage)
+{
+  SlidingStats stats(150, 0.5);
+  stats.add(4.0f);
+  EXPECT_EQ(4.0f, stats.getEma());
+  stats.add(2.0f);
+  EXPECT_EQ(3.0f, stats.getEma());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
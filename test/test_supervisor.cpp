@@ -0,0 +1,192 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "naoqi_dcm_driver/supervisor.hpp"
+
+/** control loop frequency [Hz] */
+static const double FREQ = 100.0;
+
+/** tolerance on the limits, for rounding */
+static const double EPSILON = 1e-9;
+
+//! @brief a supervisor of one joint, with limits when positive
+static void setLimits(Supervisor *supervisor,
+                      const double &pos_max,
+                      const double &vel_max,
+                      const double &acc_max,
+                      const double &step = 0.0)
+{
+  std::vector <joint_limits_interface::JointLimits> limits(1);
+  limits[0].has_position_limits = (pos_max > 0.0);
+  limits[0].min_position = -pos_max;
+  limits[0].max_position = pos_max;
+  limits[0].has_velocity_limits = (vel_max > 0.0);
+  limits[0].max_velocity = vel_max;
+  limits[0].has_acceleration_limits = (acc_max > 0.0);
+  limits[0].max_acceleration = acc_max;
+  supervisor->setLimits(std::vector <std::string>(1, "HeadYaw"), limits, step);
+}
+
+/** one joint following its clamped commands exactly */
+struct Plant
+{
+  std::vector <double> command;
+  std::vector <double> vel_command;
+  std::vector <double> angle;
+  std::vector <bool> active;
+
+  Plant():
+    command(1, 0.0),
+    vel_command(1, 0.0),
+    angle(1, 0.0),
+    active(1, true)
+  {
+  }
+
+  int step(Supervisor *supervisor, const double &target, const double &lead = 0.0)
+  {
+    command[0] = target;
+    vel_command[0] = 0.0;
+    const int res = supervisor->clamp(&command, &vel_command, angle, active, lead);
+    angle[0] = command[0];
+    return res;
+  }
+};
+
+TEST(Supervisor, CommandsWithinTheLimitsAreKept)
+{
+  Supervisor supervisor(FREQ);
+  setLimits(&supervisor, 2.0, 1.0, 0.0);
+  Plant plant;
+  EXPECT_EQ(0, plant.step(&supervisor, 0.005));
+  EXPECT_DOUBLE_EQ(0.005, plant.command[0]);
+  EXPECT_FALSE(supervisor.haveClampsChanged());
+}
+
+TEST(Supervisor, PositionIsClamped)
+{
+  Supervisor supervisor(FREQ);
+  setLimits(&supervisor, 0.5, 0.0, 0.0);
+  Plant plant;
+  EXPECT_EQ(1, plant.step(&supervisor, 1.0));
+  EXPECT_TRUE(supervisor.haveClampsChanged());
+  EXPECT_DOUBLE_EQ(0.5, plant.command[0]);
+  EXPECT_EQ(1, plant.step(&supervisor, 1.0));
+  EXPECT_FALSE(supervisor.haveClampsChanged());
+  EXPECT_EQ(1, plant.step(&supervisor, -1.0));
+  EXPECT_DOUBLE_EQ(-0.5, plant.command[0]);
+}
+
+TEST(Supervisor, StepIsClampedFromTheAngle)
+{
+  Supervisor supervisor(FREQ);
+  setLimits(&supervisor, 0.0, 0.0, 0.0, 0.01);
+  Plant plant;
+  for (int i=1; i<=10; ++i)
+  {
+    EXPECT_EQ(1, plant.step(&supervisor, 1.0));
+    EXPECT_NEAR(0.01*i, plant.command[0], EPSILON);
+  }
+}
+
+TEST(Supervisor, RampStopsAtTheTarget)
+{
+  // the velocity and acceleration limits hold, and the joint brakes without overshooting
+  const double vel_max = 1.0, acc_max = 5.0, target = 0.5;
+  Supervisor supervisor(FREQ);
+  setLimits(&supervisor, 2.0, vel_max, acc_max);
+  Plant plant;
+  double prev_pos = 0.0, prev_vel = 0.0;
+  for (int i=0; i<200; ++i)
+  {
+    plant.step(&supervisor, target);
+    const double vel = (plant.command[0] - prev_pos)*FREQ;
+    ASSERT_LE(std::fabs(vel), vel_max + EPSILON) << "at tick " << i;
+    ASSERT_LE(std::fabs(vel - prev_vel)*FREQ, acc_max + EPSILON) << "at tick " << i;
+    ASSERT_LE(plant.command[0], target + EPSILON) << "at tick " << i;
+    prev_pos = plant.command[0];
+    prev_vel = vel;
+  }
+  EXPECT_NEAR(target, plant.command[0], 1e-6);
+  EXPECT_EQ(0, plant.step(&supervisor, target));
+}
+
+TEST(Supervisor, VelocityCommandIsRamped)
+{
+  Supervisor supervisor(FREQ);
+  setLimits(&supervisor, 0.0, 1.0, 5.0);
+  Plant plant;
+  plant.vel_command[0] = 2.0;
+  EXPECT_EQ(1, supervisor.clamp(&plant.command, &plant.vel_command, plant.angle, plant.active));
+  EXPECT_NEAR(5.0/FREQ, plant.vel_command[0], EPSILON);
+  for (int i=0; i<100; ++i)
+  {
+    plant.vel_command[0] = 2.0;
+    supervisor.clamp(&plant.command, &plant.vel_command, plant.angle, plant.active);
+  }
+  EXPECT_NEAR(1.0, plant.vel_command[0], EPSILON);
+}
+
+TEST(Supervisor, ExtrapolatedTargetIsClamped)
+{
+  // at the position limit, the feedforward cannot push the target beyond it
+  const double lead = 0.05;
+  Supervisor supervisor(FREQ);
+  setLimits(&supervisor, 0.5, 0.0, 0.0, 0.02);
+  Plant plant;
+  plant.angle[0] = 0.49;
+  plant.command[0] = 0.5;
+  plant.vel_command[0] = 1.0;
+  EXPECT_EQ(1, supervisor.clamp(&plant.command, &plant.vel_command, plant.angle, plant.active, lead));
+  EXPECT_LE(plant.command[0] + plant.vel_command[0]*lead, 0.5 + EPSILON);
+  EXPECT_GE(plant.vel_command[0], 0.0);
+
+  // away from it, the step from the angle bounds the extrapolated target
+  plant.angle[0] = 0.0;
+  plant.command[0] = 0.0;
+  plant.vel_command[0] = -1.0;
+  supervisor.clamp(&plant.command, &plant.vel_command, plant.angle, plant.active, lead);
+  EXPECT_GE(plant.command[0] + plant.vel_command[0]*lead, -0.02 - EPSILON);
+  EXPECT_LE(plant.vel_command[0], 0.0);
+}
+
+TEST(Supervisor, InactiveJointsRestartFromTheirAngles)
+{
+  Supervisor supervisor(FREQ);
+  setLimits(&supervisor, 0.0, 1.0, 0.0);
+  Plant plant;
+  plant.active[0] = false;
+  plant.angle[0] = 0.3;
+  EXPECT_EQ(0, plant.step(&supervisor, 0.3));
+
+  // no jump from the angle reached while the joint was not commanded
+  plant.active[0] = true;
+  plant.step(&supervisor, 0.3);
+  EXPECT_NEAR(0.3, plant.command[0], EPSILON);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
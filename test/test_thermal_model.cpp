@@ -0,0 +1,100 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cmath>
+#include <cstdlib>
+
+#include <gtest/gtest.h>
+
+#include "naoqi_dcm_driver/thermal_model.hpp"
+
+/** diagnostics rate of the temperatures and currents [Hz] */
+static const double RATE = 10.0;
+
+/** idle joint duration [s] */
+static const double IDLE_DURATION = 4.0*3600.0;
+
+static void expectBounded(const ThermalModel &model, const double &time)
+{
+  double a, b, c;
+  model.getParameters(&a, &b, &c);
+  ASSERT_TRUE(std::isfinite(a) && std::isfinite(b) && std::isfinite(c)) << "at " << time << " s";
+  ASSERT_LT(std::fabs(a), 1.0) << "at " << time << " s";
+  ASSERT_LT(std::fabs(b), 1.0) << "at " << time << " s";
+  ASSERT_LT(std::fabs(c), 10.0) << "at " << time << " s";
+
+  // a healthy idle joint is never predicted to be already too hot
+  const double time_to = model.getTimeTo(70.0f);
+  ASSERT_FALSE(std::isnan(time_to)) << "at " << time << " s";
+  ASSERT_GT(time_to, 0.0) << "at " << time << " s";
+}
+
+TEST(ThermalModel, ConstantMeasuresDoNotWindUp)
+{
+  ThermalModel model;
+  for (int i=0; i<IDLE_DURATION*RATE; ++i)
+  {
+    const double time = i/RATE;
+    model.update(time, 35.0f, 0.1f);
+    expectBounded(model, time);
+  }
+}
+
+TEST(ThermalModel, QuantizedMeasuresDoNotWindUp)
+{
+  // the temperature sensors toggle between two degrees on a constant load
+  ThermalModel model;
+  std::srand(42);
+  for (int i=0; i<IDLE_DURATION*RATE; ++i)
+  {
+    const double time = i/RATE;
+    const float temperature = (std::rand() % 2) ? 35.0f : 36.0f;
+    model.update(time, temperature, 0.1f);
+    expectBounded(model, time);
+  }
+}
+
+TEST(ThermalModel, HeatingAfterIdle)
+{
+  // dT/dt = a*I^2 - b*(T - 30), steady temperature of 80 degrees at 2 A
+  const double a = 1.25/60.0;
+  const double b = 1.0/600.0;
+  const double current = 2.0;
+
+  ThermalModel model;
+  double temperature = 30.0;
+  for (int i=0; i<IDLE_DURATION*RATE; ++i)
+    model.update(i/RATE, static_cast<float>(temperature), 0.0f);
+
+  double time = IDLE_DURATION;
+  for (int i=0; i<600*RATE; ++i)
+  {
+    temperature += (a*current*current - b*(temperature - 30.0))/RATE;
+    time += 1.0/RATE;
+    model.update(time, static_cast<float>(temperature), static_cast<float>(current));
+  }
+
+  const double time_to = model.getTimeTo(70.0f);
+  EXPECT_TRUE(std::isfinite(time_to));
+  EXPECT_GT(time_to, 0.0);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2016 SoftBank Robotics Europe
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "naoqi_dcm_driver/topology_cache.hpp"
+
+static std::string getCachePath()
+{
+  std::ostringstream path;
+  path << "/tmp/test_topology_cache_" << getpid() << ".bin";
+  return path.str();
+}
+
+static std::vector <std::string> getHeadNames()
+{
+  std::vector <std::string> names;
+  names.push_back("HeadYaw");
+  names.push_back("HeadPitch");
+  return names;
+}
+
+//! @brief write a cache of the head of a pepper
+static void saveCache(const std::string &path)
+{
+  TopologyCache cache(path);
+  ASSERT_FALSE(cache.load("Pepper", "2.5.5"));
+  cache.setBodyNames("Head", getHeadNames());
+  cache.setBodyNames("Wheels", std::vector <std::string>());
+  ASSERT_TRUE(cache.save());
+}
+
+TEST(TopologyCache, SaveLoadRoundTrip)
+{
+  const std::string path = getCachePath();
+  saveCache(path);
+
+  TopologyCache cache(path);
+  ASSERT_TRUE(cache.load("Pepper", "2.5.5"));
+  std::vector <std::string> names;
+  ASSERT_TRUE(cache.getBodyNames("Head", &names));
+  EXPECT_EQ(getHeadNames(), names);
+  ASSERT_TRUE(cache.getBodyNames("Wheels", &names));
+  EXPECT_TRUE(names.empty());
+  EXPECT_FALSE(cache.getBodyNames("LArm", &names));
+  std::remove(path.c_str());
+}
+
+TEST(TopologyCache, VersionMismatchIsIgnored)
+{
+  const std::string path = getCachePath();
+  saveCache(path);
+
+  std::vector <std::string> names;
+  TopologyCache other_version(path);
+  EXPECT_FALSE(other_version.load("Pepper", "2.9.0"));
+  EXPECT_FALSE(other_version.getBodyNames("Head", &names));
+
+  TopologyCache other_robot(path);
+  EXPECT_FALSE(other_robot.load("Nao", "2.5.5"));
+  EXPECT_FALSE(other_robot.getBodyNames("Head", &names));
+
+  // the discovery of the new version replaces the cache
+  other_version.setBodyNames("Head", getHeadNames());
+  ASSERT_TRUE(other_version.save());
+  TopologyCache cache(path);
+  EXPECT_TRUE(cache.load("Pepper", "2.9.0"));
+  EXPECT_FALSE(TopologyCache(path).load("Pepper", "2.5.5"));
+  std::remove(path.c_str());
+}
+
+TEST(TopologyCache, InvalidFilesAreIgnored)
+{
+  EXPECT_FALSE(TopologyCache("").load("Pepper", "2.5.5"));
+  EXPECT_FALSE(TopologyCache("").save());
+
+  const std::string path = getCachePath();
+  std::remove(path.c_str());
+  EXPECT_FALSE(TopologyCache(path).load("Pepper", "2.5.5"));
+
+  {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out << "not a topology cache";
+  }
+  EXPECT_FALSE(TopologyCache(path).load("Pepper", "2.5.5"));
+
+  // a cache cut anywhere is never loaded
+  saveCache(path);
+  std::string data;
+  {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  for (size_t size=0; size<data.size(); ++size)
+  {
+    {
+      std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+      out.write(data.data(), size);
+    }
+    EXPECT_FALSE(TopologyCache(path).load("Pepper", "2.5.5")) << "truncated to " << size << " bytes";
+  }
+  std::remove(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}